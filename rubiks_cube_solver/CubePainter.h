@@ -2,92 +2,149 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstddef>
 #include <ncl/gl/Shader.h>
-#include <ncl/gl/Cube.h>
 #include <ncl/gl/Scene.h>
 #include "model.h"
 #include "moves.h"
 
 using namespace glm;
 
+/**
+	Draws the whole cube with a single instanced draw call of one shared unit cube mesh. Every cubie body
+	and sticker is an instance with its own model matrix and colour; instances on the layer being turned
+	are flagged and rotated in the vertex shader by the layerRotation uniform (see shaders/instanced.vert).
+	Instances are cached until invalidate() is called, so a frame during a move only updates that uniform.
+*/
 class CubePainter {
 public:
 	CubePainter(rubiks::RubiksCube& cube) :rubiksCube(cube) {}
 
-	~CubePainter() {;
+	~CubePainter() {
+		glDeleteBuffers(1, &instanceBuffer);
+		glDeleteBuffers(1, &meshBuffer);
+		glDeleteVertexArrays(1, &vao);
 	}
 
 	void init() {
-		using namespace rubiks;
-		for (int i = 0; i < NUM_CUBES; i++) {
-			cubes[i][0] = new ncl::gl::Cube(1.0f, 10, ncl::gl::BLACK);
-			cubes[i][1] = new ncl::gl::Cube(0.9, 10, vec4(rubiksCube.cubes[i].zc, 1.0));
-			if (rubiksCube.cubes[i].type == EDGE || rubiksCube.cubes[i].type == CORNER) {
-				cubes[i][2] = new ncl::gl::Cube(0.9, 10, vec4(rubiksCube.cubes[i].yc, 1.0));
-			}
-			if (rubiksCube.cubes[i].type == CORNER) {
-				cubes[i][3] = new ncl::gl::Cube(0.9, 10, vec4(rubiksCube.cubes[i].xc, 1.0));
-			}
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+
+		vector<vec3> mesh = unitCube();
+		glGenBuffers(1, &meshBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(vec3), &mesh[0], GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(vec3), (void*)0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(vec3), (void*)sizeof(vec3));
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		numVertices = mesh.size() / 2;
+
+		glGenBuffers(1, &instanceBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, MAX_INSTANCES * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+		for (int i = 0; i < 4; i++) {
+			glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, model) + i * sizeof(vec4)));
 		}
+		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, color));
+		glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, moving));
+		for (int i = 2; i < 8; i++) {
+			glEnableVertexAttribArray(i);
+			glVertexAttribDivisor(i, 1);
+		}
+
+		glBindVertexArray(0);
+	}
+
+	// the model changed, instances are rebuilt on the next paint
+	void invalidate() {
+		stale = true;
 	}
 
 	void paint(ncl::gl::Shader& s, ncl::gl::GlmCam& cam, rubiks::Move* move, float angle) {
-		using namespace rubiks;
+		if (stale) {
+			numInstances = updateInstances(move);
+			stale = false;
+		}
+
+		cam.model = mat4(1);
+		s.sendComputed(cam);
+
+		GLint program;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		mat4 viewProjection = cam.projection * cam.view;
+		mat4 layerRotation = move ? rotate(mat4(1), radians(angle), move->rotation.axis) : mat4(1);
+		glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, value_ptr(viewProjection));
+		glUniformMatrix4fv(glGetUniformLocation(program, "layerRotation"), 1, GL_FALSE, value_ptr(layerRotation));
+
+		glBindVertexArray(vao);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, numVertices, numInstances);
+		glBindVertexArray(0);
+	}
+
+private:
+	struct Instance {
 		mat4 model;
+		vec4 color;
+		float moving;
+	};
+
+	// a body for every cubie plus one sticker per coloured face
+	const static int MAX_INSTANCES = NUM_CUBES * 4;
+
+	// rebuilds the instance buffer from the model, returns the number of instances written
+	int updateInstances(rubiks::Move* move) {
+		using namespace rubiks;
+		int count = 0;
+		auto add = [&](const mat4& model, const vec3 color, bool moving) {
+			instances[count++] = { model, vec4(color, 1.0), moving ? 1.0f : 0.0f };
+		};
+
 		for (int i = 0; i < NUM_CUBES; i++) {
-			auto cube = rubiksCube.cubes[i];
-			if (move != nullptr && move->affects(cube)) {
-				model = rotate(mat4(1), radians(angle), move->rotation.axis);
-				mat4& base = translate(model, rubiksCube.cubes[i].pos);
-				cam.model = base;
-				s.sendComputed(cam);
-				cubes[i][0]->draw(s);
-
-				vec3 pos = vec3(0.1);
-				cam.model = translate(base, cube.fz * pos);
-				s.sendComputed(cam);
-				cubes[i][1]->draw(s);
-
-				if (rubiksCube.cubes[i].type == EDGE || rubiksCube.cubes[i].type == CORNER) {
-					cam.model = translate(base, cube.fy * pos);
-					s.sendComputed(cam);
-					cubes[i][2]->draw(s);
-				}
-
-				if (rubiksCube.cubes[i].type == CORNER) {
-					cam.model = translate(base, cube.fx * pos);
-					s.sendComputed(cam);
-					cubes[i][3]->draw(s);
-				}
+			Cube& cube = rubiksCube.cubes[i];
+			bool moving = move != nullptr && move->affects(cube);
+			mat4 base = translate(mat4(1), cube.pos);
+			add(base, vec3(0), moving);
+
+			vec3 offset = vec3(0.1);
+			add(scale(translate(base, cube.fz * offset), vec3(0.9)), cube.zc, moving);
+			if (cube.type == EDGE || cube.type == CORNER) {
+				add(scale(translate(base, cube.fy * offset), vec3(0.9)), cube.yc, moving);
 			}
-			else {
-				mat4& base = translate(mat4(1), rubiksCube.cubes[i].pos);
-				cam.model = base;
-				s.sendComputed(cam);
-				cubes[i][0]->draw(s);
-
-				vec3 pos = vec3(0.1);
-				cam.model = translate(base, cube.fz * pos);
-				s.sendComputed(cam);
-				cubes[i][1]->draw(s);
-
-				if (rubiksCube.cubes[i].type == EDGE || rubiksCube.cubes[i].type == CORNER) {
-					cam.model = translate(base, cube.fy * pos);
-					s.sendComputed(cam);
-					cubes[i][2]->draw(s);
-				}
-
-				if (rubiksCube.cubes[i].type == CORNER) {
-					cam.model = translate(base, cube.fx * pos);
-					s.sendComputed(cam);
-					cubes[i][3]->draw(s);
-				}
+			if (cube.type == CORNER) {
+				add(scale(translate(base, cube.fx * offset), vec3(0.9)), cube.xc, moving);
 			}
 		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Instance), instances);
+		return count;
 	}
 
-private:
-	rubiks::RubiksCube& rubiksCube;
-	ncl::gl::Cube* cubes[NUM_CUBES][4];
+	// interleaved position and normal of a unit cube centered on the origin
+	static vector<vec3> unitCube() {
+		vector<vec3> vertices;
+		vec3 normals[6] = { rubiks::FRONT, rubiks::BACK, rubiks::RIGHT, rubiks::LEFT, rubiks::UP, rubiks::DOWN };
+		for (vec3 n : normals) {
+			vec3 u = n.y == 0 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+			vec3 v = cross(n, u);
+			vec3 corners[4] = { n - u - v, n + u - v, n + u + v, n - u + v };
+			int order[6] = { 0, 1, 2, 0, 2, 3 };
+			for (int i : order) {
+				vertices.push_back(corners[i] * 0.5f);
+				vertices.push_back(n);
+			}
+		}
+		return vertices;
+	}
 
-};
\ No newline at end of file
+	rubiks::RubiksCube& rubiksCube;
+	Instance instances[MAX_INSTANCES];
+	GLuint vao = 0;
+	GLuint meshBuffer = 0;
+	GLuint instanceBuffer = 0;
+	GLsizei numVertices = 0;
+	GLsizei numInstances = 0;
+	bool stale = true;
+};
@@ -2,10 +2,14 @@
 
 #include <ncl/gl/Scene.h>
 #include <ncl/gl/Scene.h>
+#include <GLFW/glfw3.h>
 #include <algorithm>
-#include <queue>
+#include <thread>
+#include <atomic>
 #include "moves.h"
 #include "solver.h"
+#include "spsc_queue.h"
+#include "timeline.h"
 #include "CubePainter.h"
 
 using namespace std;
@@ -21,44 +25,53 @@ public:
 		move = nullptr;
 	}
 
+	~RubiksCubeScene() {
+		stopSolving();
+	}
+
 	virtual void init() override {
 		painter = new CubePainter(rubiksCube);
 		painter->init();
-		initLights();
 		using namespace rubiks;
 
 		solver = new SimpleSolver;
 
 		cam.view = glm::lookAt(vec3(3.0f, 3.25f, 3.25f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+		timeline.reset(rubiksCube);
 		nextMove();
 		glClearColor(0.5, 0.5, 0.5, 1);
 	}
 
-	void initLights() {
-		light[0].position = vec4(0, 0, 3, 1);
-		light[1].position = vec4(0, 3, 0, 1);
-		light[2].position = vec4(3, 0, 0, 1);
-		light[3].position = vec4(0, 0, -3, 1);
-		light[4].position = vec4(0, -3, 0, 1);
-		light[5].position = vec4(-3, 0, 0, 1);
-
-		for (int i = 1; i < 6; i++) light[i].on = true;
-	}
-
 	virtual void display() override {
-		shader("default")([&](Shader& s) {
-			mat4 model;
-			s.sendUniformLight("light[0]", light[0]);
+		shader("instanced")([&](Shader& s) {
 			painter->paint(s, cam, move, angle);
 		});
 	}
 
 	virtual void resized() override {
 		cam.projection = glm::perspective(glm::radians(60.0f), aspectRatio, 0.3f, 100.0f);
+		changed();
 	}
 
 	virtual void update(float dt) override {
+		/**
+			Nothing to animate: block until there is input. The ncl loop still draws and swaps once after every
+			update, so an idle scene draws a frame per input event instead of one per vsync. Nothing but input
+			ends idling; a solve is started from input and keeps the scene busy until its moves are played.
+		*/
+		if (idle()) {
+			glfwWaitEvents();
+			return;
+		}
+		if (redrawFrames > 0) redrawFrames--;
+
+		dt = std::min(dt, MAX_FRAME_TIME);	// the first frame after idling covers the whole wait
+		if (move == nullptr && !moves.empty()) {	// moves streamed in by the solver, or left by fastForward
+			nextMove();
+		}
 		if (move) {
+			changed();
+			speed = playbackSpeed();
 			float limit = move->rotation.amout;
 			if (limit > 0) {
 				angle += dt * speed;
@@ -75,117 +88,199 @@ public:
 		}
 	}
 
+	/**
+		Long queues (scrambles, solutions) are applied straight to the model, FAST_FORWARD_BUDGET moves a
+		frame, and only the last moves are animated. Called between moves, never while one is turning.
+	*/
+	void fastForward() {
+		rubiks::MoveCode skipped;
+		for (int i = 0; i < FAST_FORWARD_BUDGET && moves.size() >= ANIMATED_MOVES && moves.pop(skipped); i++) {
+			rubiks::applyMove(rubiksCube, skipped);
+			timeline.record(skipped, rubiksCube);
+		}
+	}
+
+	// degrees per second, faster the more moves are still waiting
+	float playbackSpeed() const {
+		return std::min(BASE_SPEED * (1 + moves.size() / SPEED_RAMP), MAX_SPEED);
+	}
+
+	// something visible changed, keep drawing until both buffers show it
+	void changed() {
+		redrawFrames = 2;
+	}
+
+	bool idle() const {
+		return move == nullptr && moves.empty() && redrawFrames == 0 && !solving;
+	}
+
+	// finishes the move that is turning, then starts animating the next one unless the queue is still too long for it
 	void nextMove() {
 		if (move) {
-			move->applyTo(rubiksCube);
-			undo.push(move); 
+			rubiks::applyMove(rubiksCube, moveCode);
+			timeline.record(moveCode, rubiksCube);
 			move = nullptr;
 		}
-		if (!moves.empty()) {
-			move = moves.front();
-			moves.pop();
+		fastForward();
+		painter->invalidate();
+		changed();
+		if (moves.size() < ANIMATED_MOVES && moves.pop(moveCode)) {
+			move = rubiks::allMoves[moveCode];
 			angle = 0;
 		}
-		else {
-			scrambling = false;
-		}
 	}
 
 	virtual void processInput(const Key& key) override {
 		using namespace rubiks;
-		queue<Move*> scram;
-		if (key.status == Key::RELEASED && move == nullptr) {
+		if (key.status == Key::RELEASED && move == nullptr && !solving) {
 			switch (key.value()) {
 			case 'r':
-				moves.push(&R);
+				moves.push(codeOf(R));
 				break;
 			case 'R':
-				moves.push(&_R);
+				moves.push(codeOf(_R));
 				break;
 			case 'l':
-				moves.push(&L);
+				moves.push(codeOf(L));
 				break;
 			case 'L':
-				moves.push(&_L);
+				moves.push(codeOf(_L));
 				break;
 			case 'u':
-				moves.push(&U);
+				moves.push(codeOf(U));
 				break;
 			case 'U':
-				moves.push(&_U);
+				moves.push(codeOf(_U));
 				break;
 			case 'd':
-				moves.push(&D);
+				moves.push(codeOf(D));
 				break;
 			case 'D':
-				moves.push(&_D);
+				moves.push(codeOf(_D));
 				break;
 			case 'f':
-				moves.push(&F);
+				moves.push(codeOf(F));
 				break;
 			case 'F':
-				moves.push(&_F);
+				moves.push(codeOf(_F));
 				break;
 			case 'b':
-				moves.push(&B);
+				moves.push(codeOf(B));
 				break;
 			case 'B':
-				moves.push(&_B);
+				moves.push(codeOf(_B));
 				break;
 			case 's':
-				//scram = superFlip();
-				scram = scramble(50);
-				while (!scram.empty()) {
-					moves.push(scram.front());
-					scram.pop();
-				}
-				scrambling = true;
-				speed = 700;
+				//for (MoveCode m : superFlip()) moves.push(m);
+				for (MoveCode m : scramble(50)) moves.push(m);
 				break;
 			case 'e':
-				moves.push(&d);
+				moves.push(codeOf(d));
 				break;
 			case 263:
-				moves.push(&SPIN_LEFT);
+				moves.push(codeOf(SPIN_LEFT));
 				break;
 			case 262:
-				moves.push(&SPIN_RIGHT);
+				moves.push(codeOf(SPIN_RIGHT));
 				break;
 			case 264:
-				moves.push(&SPIN_DOWN);
+				moves.push(codeOf(SPIN_DOWN));
 				break;
 			case 265:
-				moves.push(&SPIN_UP);
+				moves.push(codeOf(SPIN_UP));
 				break;
 			case ' ':
-				moves = solver->solve(rubiksCube);
+				solveInBackground();
 				break;
 			case 'i':
 				load(rubiksCube);
+				timeline.reset(rubiksCube);
 				break;
 			case 'o':
 				save(rubiksCube);
 				break;
+			case 'p':
+				reportCounters(cout);
+				break;
 			case 'c':
 				rubiksCube.reset();
+				timeline.reset(rubiksCube);
+				break;
+			case ',':
+				timeline.back(rubiksCube);
+				break;
+			case '.':
+				timeline.forward(rubiksCube);
+				break;
+			case '<':
+				timeline.seek(rubiksCube, 0);
+				break;
+			case '>':
+				timeline.seek(rubiksCube, timeline.size());
+				break;
 			default:
 				break;
 			}
-			if (!scrambling) speed = 300;
 			nextMove();
 		}
 	}
 
+	/**
+		Solves a snapshot of the cube on a worker thread, which becomes the only producer of moves until it is
+		done; input is ignored meanwhile. Moves are animated as soon as the solver hands them over.
+	*/
+	void solveInBackground() {
+		if (worker.joinable()) worker.join();
+		cancelSolve.reset();
+		solving = true;
+		worker = thread([this](rubiks::RubiksCube snapshot) {
+			rubiks::SolveLimits limits;
+			limits.token = &cancelSolve;
+			try {
+				solver->stream(snapshot, [&](rubiks::MoveCode m) {
+					while (!moves.push(m)) {	// the queue is only drained while the window is open
+						if (cancelSolve.isCancelled()) throw "solve cancelled";
+						this_thread::yield();
+					}
+				}, limits);
+			}
+			catch (const char* msg) {
+				RUBIKS_TRACE(rubiks::TRACE_ERROR, "solve failed: %s", msg);
+			}
+			catch (const exception& e) {
+				RUBIKS_TRACE(rubiks::TRACE_ERROR, "solve failed: %s", e.what());
+			}
+			catch (...) {
+				RUBIKS_TRACE(rubiks::TRACE_ERROR, "solve failed");
+			}
+			solving = false;
+		}, rubiksCube);
+	}
+
+	// cancels a solve in progress and waits for its worker, which may be blocked on a full queue
+	void stopSolving() {
+		cancelSolve.cancel();
+		if (worker.joinable()) worker.join();
+	}
+
 private:
 	float angle;
-	ncl::gl::Cube* cubes[NUM_CUBES][4];
-	ncl::gl::Sphere* sphere;
 	rubiks::RubiksCube rubiksCube;
-	queue<rubiks::Move*> moves;
-	stack<rubiks::Move*> undo;
+	rubiks::SpscQueue<rubiks::MoveCode, 1024> moves;
+	rubiks::Timeline timeline;
 	rubiks::Move* move;
+	rubiks::MoveCode moveCode;	// index of move into allMoves
 	float speed = 300;
-	bool scrambling = false;
+	const float BASE_SPEED = 300;
+	const float MAX_SPEED = 1500;
+	const float SPEED_RAMP = 4;
+	const size_t ANIMATED_MOVES = 12;
+	const int FAST_FORWARD_BUDGET = 10;
+	int redrawFrames = 2;
+	const float MAX_FRAME_TIME = 1.0f / 30;
 	rubiks::Solver* solver;
+	thread worker;
+	atomic<bool> solving{ false };
+	rubiks::CancellationToken cancelSolve;
 	CubePainter* painter;
 };
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include "model.h"
+#include "moves.h"
+#include "state.h"
+#include "state_key.h"
+#include "state_table.h"
+#include "solver.h"
+
+namespace rubiks {
+
+	/**
+		Optimal solver for cubes that are only a few moves from solved. It grows a breadth first search
+		from the scrambled state and one from the solved state, always expanding the smaller frontier,
+		until the two meet. No tables are needed, but memory grows quickly with depth, so the solver gives
+		up and returns no moves past maxDepth quarter turns or when the limits are hit; use it as a first
+		attempt before SimpleSolver. Visited states are packed into StateKeys, 19 bytes a slot in the maps
+		and 16 in the frontiers.
+	*/
+	class BidirectionalSolver : public Solver {
+	public:
+		BidirectionalSolver(int maxDepth = 12) :maxDepth(maxDepth) {}
+
+		virtual Solution solve(RubiksCube& cube, const SolveLimits& limits = SolveLimits()) override {
+			Solution moves;
+			for (int move : search(stateOf(cube), limits)) {
+				moves.push_back(MoveCode(move));
+			}
+			return moves;
+		}
+
+		// optimal sequence of face moves (indices into allMoves) that solves state, none when limits are hit first
+		vector<int> search(const CubeState& state, const SolveLimits& limits = SolveLimits()) {
+			const CubeState goal = CubeState::solved();
+			if (state == goal) return{};
+
+			Visited forward, backward;
+			StateKey start(state), solved(goal);
+			forward.insert(start, { NONE, 0 });
+			backward.insert(solved, { NONE, 0 });
+			vector<StateKey> forwardFrontier{ start };
+			vector<StateKey> backwardFrontier{ solved };
+			int forwardDepth = 0;
+			int backwardDepth = 0;
+
+			while (forwardDepth + backwardDepth < maxDepth && !forwardFrontier.empty() && !backwardFrontier.empty()) {
+				bool expandForward = forwardFrontier.size() <= backwardFrontier.size();
+				Visited& visited = expandForward ? forward : backward;
+				Visited& other = expandForward ? backward : forward;
+				vector<StateKey>& frontier = expandForward ? forwardFrontier : backwardFrontier;
+				int& depth = expandForward ? forwardDepth : backwardDepth;
+
+				vector<StateKey> next;
+				StateKey meet;
+				int best = maxDepth + 1;
+				size_t expanded = 0;
+				for (const StateKey& key : frontier) {
+					if (++expanded % LIMIT_CHECK_INTERVAL == 0 && limits.expired()) return{};
+					uint8_t last = visited.find(key)->move;
+					CubeState s = key.state();
+					for (int move = 0; move < NUM_FACE_MOVES; move++) {
+						if (last != NONE && redundant(last, move)) continue;
+						StateKey t(applyMove(s, move));
+						if (!visited.insert(t, { uint8_t(move), uint8_t(depth + 1) }).second) continue;
+						next.push_back(t);
+
+						const Visit* found = other.find(t);
+						if (found && depth + 1 + found->depth < best) {
+							best = depth + 1 + found->depth;
+							meet = t;
+						}
+					}
+				}
+				depth++;
+				frontier.swap(next);
+
+				if (best <= maxDepth) {
+					vector<int> res = pathTo(meet, forward);
+					vector<int> back = pathTo(meet, backward);
+					for (auto it = back.rbegin(); it != back.rend(); it++) {
+						res.push_back(inverseOf(*it));
+					}
+					return res;
+				}
+			}
+			return{};
+		}
+
+	private:
+		struct Visit {
+			uint8_t move;
+			uint8_t depth;
+		};
+
+		using Visited = StateMap<Visit>;
+		const static uint8_t NONE = 0xFF;
+		const static size_t LIMIT_CHECK_INTERVAL = 256;	// states expanded between looks at the clock
+		int maxDepth;
+
+		// undoes the last move, or turns the opposite face first when the two commute
+		static bool redundant(int last, int move) {
+			int face = move % 6;
+			int lastFace = last % 6;
+			int opposite = lastFace < 4 ? (lastFace + 2) % 4 : 9 - lastFace;
+			return move == inverseOf(last) || (face == opposite && face < lastFace);
+		}
+
+		// moves leading from the root of visited to key
+		vector<int> pathTo(StateKey key, const Visited& visited) {
+			vector<int> path;
+			CubeState state = key.state();
+			for (uint8_t move = visited.find(key)->move; move != NONE; move = visited.find(key)->move) {
+				path.push_back(move);
+				state = applyMove(state, inverseOf(move));
+				key = StateKey(state);
+			}
+			reverse(path.begin(), path.end());
+			return path;
+		}
+	};
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "large_pages.h"
+#include "model.h"
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		Coordinates of a CubeState that face moves act on by themselves: the corner twists, the edge flips,
+		the corner permutation and which slots hold the four E slice edges (FR, FL, BL, BR). NONE is a
+		coordinate with a single value, for tables on one coordinate.
+	*/
+	enum Coordinate { TWIST, FLIP, CORNERS, SLICE, NONE, NUM_COORDINATES };
+
+	const int COORDINATE_SIZES[NUM_COORDINATES] = { 2187, 2048, 40320, 495, 1 };
+
+	const int BINOMIAL_ROW = NUM_EDGES / 3 + 1;
+
+	// n choose k at n * BINOMIAL_ROW + k, for n < NUM_EDGES and k up to the four slice edges
+	const int* binomials() {
+		static int table[NUM_EDGES * BINOMIAL_ROW] = {};
+		static bool initialized = [&]() {
+			for (int n = 0; n < NUM_EDGES; n++) {
+				table[n * BINOMIAL_ROW] = 1;
+				for (int k = 1; k < BINOMIAL_ROW; k++) table[n * BINOMIAL_ROW + k] = n == 0 ? 0 : table[(n - 1) * BINOMIAL_ROW + k - 1] + table[(n - 1) * BINOMIAL_ROW + k];
+			}
+			return true;
+		}();
+		return table;
+	}
+
+	int coordinateOf(const CubeState& state, Coordinate coordinate) {
+		int res = 0;
+		switch (coordinate) {
+		case TWIST:	// the last twist follows from the others
+			for (int i = NUM_CORNERS - 2; i >= 0; i--) res = res * 3 + state.co[i];
+			return res;
+		case FLIP:
+			for (int i = NUM_EDGES - 2; i >= 0; i--) res = res * 2 + state.eo[i];
+			return res;
+		case CORNERS:	// lehmer code
+			for (int i = 0; i < NUM_CORNERS; i++) {
+				int smaller = 0;
+				for (int j = i + 1; j < NUM_CORNERS; j++) smaller += state.cp[j] < state.cp[i];
+				res = res * (NUM_CORNERS - i) + smaller;
+			}
+			return res;
+		case SLICE: {	// combinatorial number system over the slots holding slice edges
+			const int* choose = binomials();
+			int k = 0;
+			for (int i = 0; i < NUM_EDGES; i++) {	// branch free, the slice edges can be anywhere
+				int slice = state.ep[i] >= FR;
+				k += slice;
+				res += slice * choose[i * BINOMIAL_ROW + k];
+			}
+			return res;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	/**
+		Coordinate reached by every face move from every value of coordinate, one row of NUM_FACE_MOVES
+		entries per value. Values are reached with a breadth first search from solved that keeps one state
+		for each, which is enough because the coordinate alone decides where a move takes it.
+	*/
+	vector<uint16_t> coordinateMoves(Coordinate coordinate) {
+		int size = COORDINATE_SIZES[coordinate];
+		vector<uint16_t> moves(size * NUM_FACE_MOVES);
+		vector<CubeState> representatives(size);
+		vector<bool> seen(size, false);
+		const CubeState* faceMoves = faceMoveStates();
+
+		queue<int> open;
+		int start = coordinateOf(CubeState::solved(), coordinate);
+		representatives[start] = CubeState::solved();
+		seen[start] = true;
+		open.push(start);
+		while (!open.empty()) {
+			int c = open.front();
+			open.pop();
+			for (int m = 0; m < NUM_FACE_MOVES; m++) {
+				CubeState next = representatives[c] * faceMoves[m];
+				int n = coordinateOf(next, coordinate);
+				moves[c * NUM_FACE_MOVES + m] = uint16_t(n);
+				if (seen[n]) continue;
+				seen[n] = true;
+				representatives[n] = next;
+				open.push(n);
+			}
+		}
+		return moves;
+	}
+
+	struct PatternTable {
+		Coordinate first;
+		Coordinate second;
+	};
+
+	const int NUM_PATTERN_TABLES = 4;
+	const PatternTable PATTERN_TABLES[NUM_PATTERN_TABLES] = { { TWIST, FLIP }, { SLICE, FLIP }, { SLICE, TWIST }, { CORNERS, NONE } };
+
+	/**
+		Exact distances in quarter turns to solved of the pair of coordinates each table covers, four bits per
+		entry. Every table is a relaxation of the cube, so the largest of them never overestimates and
+		lowerBound is admissible for searches counting quarter turns. All tables share one 3.3 MB block that
+		is built on first use, in under a second, unless attach gave instance() a block built elsewhere.
+	*/
+	class PatternTables {
+	public:
+		static const PatternTables& instance() {
+			static PatternTables tables(attached());
+			return tables;
+		}
+
+		/**
+			Makes instance() read the tables in the size() bytes at block, which buildInto filled in and which
+			must stay mapped while the process runs, instead of building its own. False when instance() was
+			used before and already has a block.
+		*/
+		static bool attach(const uint8_t* block) {
+			attached() = block;
+			return instance().data() == block;
+		}
+
+		/**
+			Copies the block instance() has into memory in pages of the size asked for: a single copy, spread
+			over the memory nodes with NUMA_INTERLEAVE, or with NUMA_REPLICATE one on every node, which local()
+			hands to the threads pinned there. SMALL_PAGES with NUMA_DEFAULT drops the copies and goes back to
+			instance(). Only while no thread looks up; tells how the copies are backed.
+		*/
+		static string place(PageSize pages, NumaPlacement numa) {
+			const uint8_t* source = instance().data();
+			vector<Replica>& copies = replicas();
+			copies.clear();
+			if (pages == SMALL_PAGES && numa == NUMA_DEFAULT) return "the tables instance() has";
+			int count = numa == NUMA_REPLICATE ? numaNodes() : 1;
+			for (int n = 0; n < count; n++) {
+				Replica replica;
+				replica.memory.reset(new PlacedMemory(size(), pages, numa == NUMA_REPLICATE ? n : numa == NUMA_INTERLEAVE ? INTERLEAVED : ANY_NODE));
+				copy(source, source + size(), replica.memory->data());
+				replica.tables.reset(new PatternTables(replica.memory->data()));
+				copies.push_back(std::move(replica));
+			}
+			return copies[0].memory->describe();
+		}
+
+		// the copy for the node of the calling thread, instance() until place is used
+		static const PatternTables& local() {
+			const vector<Replica>& copies = replicas();
+			if (copies.empty()) return instance();
+			return *copies[size_t(currentNode()) < copies.size() ? currentNode() : 0].tables;
+		}
+
+		// bytes of the block, every table starting on a byte
+		static size_t size() {
+			return offsetOf(NUM_PATTERN_TABLES);
+		}
+
+		static void buildInto(uint8_t* block) {
+			fill(block, block + size(), uint8_t(0xFF));
+			vector<uint16_t> moves[NUM_COORDINATES];
+			for (int c = 0; c < NUM_COORDINATES; c++) moves[c] = coordinateMoves(Coordinate(c));
+			for (int t = 0; t < NUM_PATTERN_TABLES; t++) build(block, t, moves[PATTERN_TABLES[t].first], moves[PATTERN_TABLES[t].second]);
+		}
+
+		int lowerBound(const CubeState& state) const {
+			int coordinates[NUM_COORDINATES];
+			for (int c = 0; c < NUM_COORDINATES; c++) coordinates[c] = coordinateOf(state, Coordinate(c));
+			int bound = 0;
+			for (int t = 0; t < NUM_PATTERN_TABLES; t++) bound = max(bound, distance(block, t, indexOf(t, coordinates)));
+			return bound;
+		}
+
+		// computes the entries of a group of states before reading any, so the reads overlap their cache misses
+		void lowerBounds(const CubeState* states, size_t count, uint8_t* bounds) const {
+			const size_t GROUP = 16;
+			size_t indices[GROUP][NUM_PATTERN_TABLES];
+			for (size_t first = 0; first < count; first += GROUP) {
+				size_t n = min(GROUP, count - first);
+				for (size_t i = 0; i < n; i++) {
+					int coordinates[NUM_COORDINATES];
+					for (int c = 0; c < NUM_COORDINATES; c++) coordinates[c] = coordinateOf(states[first + i], Coordinate(c));
+					for (int t = 0; t < NUM_PATTERN_TABLES; t++) indices[i][t] = indexOf(t, coordinates);
+				}
+				for (size_t i = 0; i < n; i++) {
+					int bound = 0;
+					for (int t = 0; t < NUM_PATTERN_TABLES; t++) bound = max(bound, distance(block, t, indices[i][t]));
+					bounds[first + i] = uint8_t(bound);
+				}
+			}
+		}
+
+		// the whole block, size() bytes
+		const uint8_t* data() const {
+			return block;
+		}
+
+	private:
+		const static uint8_t UNSEEN = 0xF;
+
+		PatternTables(const uint8_t* existing) :block(existing) {
+			if (block) return;
+			owned.resize(size());
+			buildInto(owned.data());
+			block = owned.data();
+		}
+
+		struct Replica {
+			unique_ptr<PlacedMemory> memory;
+			unique_ptr<PatternTables> tables;
+		};
+
+		static vector<Replica>& replicas() {
+			static vector<Replica> copies;
+			return copies;
+		}
+
+		static const uint8_t*& attached() {
+			static const uint8_t* block = nullptr;
+			return block;
+		}
+
+		static size_t entriesOf(int table) {
+			return size_t(COORDINATE_SIZES[PATTERN_TABLES[table].first]) * COORDINATE_SIZES[PATTERN_TABLES[table].second];
+		}
+
+		static size_t offsetOf(int table) {
+			size_t offset = 0;
+			for (int t = 0; t < table; t++) offset += (entriesOf(t) + 1) / 2;
+			return offset;
+		}
+
+		static size_t indexOf(int table, const int* coordinates) {
+			return size_t(coordinates[PATTERN_TABLES[table].first]) * COORDINATE_SIZES[PATTERN_TABLES[table].second] + coordinates[PATTERN_TABLES[table].second];
+		}
+
+		static int distance(const uint8_t* block, int table, size_t index) {
+			return (block[offsets()[table] + index / 2] >> (index % 2 * 4)) & 0xF;
+		}
+
+		static void setDistance(uint8_t* block, int table, size_t index, int d) {
+			uint8_t& entry = block[offsets()[table] + index / 2];
+			int shift = index % 2 * 4;
+			entry = uint8_t((entry & ~(0xF << shift)) | (d << shift));
+		}
+
+		static const size_t* offsets() {
+			static size_t table[NUM_PATTERN_TABLES];
+			static bool initialized = [&]() {
+				for (int t = 0; t < NUM_PATTERN_TABLES; t++) table[t] = offsetOf(t);
+				return true;
+			}();
+			return table;
+		}
+
+		// breadth first, one sweep over the table per depth instead of a queue of millions of entries
+		static void build(uint8_t* block, int table, const vector<uint16_t>& firstMoves, const vector<uint16_t>& secondMoves) {
+			int secondSize = COORDINATE_SIZES[PATTERN_TABLES[table].second];
+			size_t entries = entriesOf(table);
+			int solved[NUM_COORDINATES];
+			for (int c = 0; c < NUM_COORDINATES; c++) solved[c] = coordinateOf(CubeState::solved(), Coordinate(c));
+			setDistance(block, table, indexOf(table, solved), 0);
+
+			for (int depth = 0; ; depth++) {
+				size_t reached = 0;
+				for (size_t i = 0; i < entries; i++) {
+					if (distance(block, table, i) != depth) continue;
+					const uint16_t* first = &firstMoves[i / secondSize * NUM_FACE_MOVES];
+					const uint16_t* second = &secondMoves[i % secondSize * NUM_FACE_MOVES];
+					for (int m = 0; m < NUM_FACE_MOVES; m++) {
+						size_t next = size_t(first[m]) * secondSize + second[m];
+						if (distance(block, table, next) != UNSEEN) continue;
+						if (depth + 1 >= UNSEEN) throw "pattern table too deep for four bits";
+						setDistance(block, table, next, depth + 1);
+						reached++;
+					}
+				}
+				if (reached == 0) break;
+			}
+		}
+
+		const uint8_t* block;
+		vector<uint8_t> owned;	// the block when it was built here
+	};
+
+	/**
+		Quarter turns a state needs at least to be solved, read off the pattern tables in about a hundred
+		nanoseconds. Cheap enough to sort incoming cubes by difficulty before picking a solver.
+	*/
+	int lowerBound(const CubeState& state) {
+		return PatternTables::local().lowerBound(state);
+	}
+
+	// reading the state off the model costs more than the lookup, keep states around when bounding many cubes
+	int lowerBound(const RubiksCube& rCube) {
+		return lowerBound(stateOf(rCube));
+	}
+
+	// bounds[i] gets lowerBound(states[i])
+	void lowerBounds(const CubeState* states, size_t count, uint8_t* bounds) {
+		PatternTables::local().lowerBounds(states, count, bounds);
+	}
+
+	vector<uint8_t> lowerBounds(const vector<CubeState>& states) {
+		vector<uint8_t> bounds(states.size());
+		lowerBounds(states.data(), states.size(), bounds.data());
+		return bounds;
+	}
+}
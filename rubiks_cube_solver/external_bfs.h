@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "state.h"
+#include "enumerate.h"
+
+namespace rubiks {
+
+	// lehmer code of the n items of p, a permutation of 0 to n - 1
+	uint64_t rankPermutation(const uint8_t* p, int n) {
+		uint64_t rank = 0;
+		for (int i = 0; i < n; i++) {
+			int smaller = 0;
+			for (int j = i + 1; j < n; j++) smaller += p[j] < p[i];
+			rank = rank * (n - i) + smaller;
+		}
+		return rank;
+	}
+
+	void unrankPermutation(uint64_t rank, uint8_t* p, int n) {
+		int digits[NUM_EDGES];
+		for (int i = n - 1; i >= 0; i--) {
+			digits[i] = int(rank % (n - i));
+			rank /= n - i;
+		}
+		bool used[NUM_EDGES] = {};
+		for (int i = 0; i < n; i++) {
+			int item = 0;
+			for (int k = digits[i]; used[item] || k > 0; item++) {
+				if (!used[item]) k--;
+			}
+			used[item] = true;
+			p[i] = uint8_t(item);
+		}
+	}
+
+	/**
+		A state numbered densely: corners is the corner permutation rank times 3^7 plus the twists, edges the
+		edge permutation rank times 2^11 plus the flips, 66 bits together where a StateKey spreads over 100.
+		Sorted states then lie close, which is what makes the delta coded run files small.
+	*/
+	struct RankedState {
+		uint64_t corners;
+		uint64_t edges;
+		uint16_t lastMoves;	// as in DepthEnumerator::Position
+
+		bool operator<(const RankedState& other) const {
+			return corners != other.corners ? corners < other.corners : edges < other.edges;
+		}
+
+		bool sameState(const RankedState& other) const {
+			return corners == other.corners && edges == other.edges;
+		}
+	};
+
+	RankedState rankOf(const CubeState& state, uint16_t lastMoves) {
+		uint64_t twist = 0, flip = 0;
+		for (int i = NUM_CORNERS - 2; i >= 0; i--) twist = twist * 3 + state.co[i];
+		for (int i = NUM_EDGES - 2; i >= 0; i--) flip = flip * 2 + state.eo[i];
+		return{ rankPermutation(state.cp, NUM_CORNERS) * 2187 + twist, rankPermutation(state.ep, NUM_EDGES) * 2048 + flip, lastMoves };
+	}
+
+	CubeState stateOf(const RankedState& ranked) {
+		CubeState state;
+		unrankPermutation(ranked.corners / 2187, state.cp, NUM_CORNERS);
+		unrankPermutation(ranked.edges / 2048, state.ep, NUM_EDGES);
+		uint64_t twist = ranked.corners % 2187, flip = ranked.edges % 2048;
+		int twists = 0, flips = 0;
+		for (int i = 0; i < NUM_CORNERS - 1; i++, twist /= 3) {
+			state.co[i] = uint8_t(twist % 3);
+			twists += state.co[i];
+		}
+		for (int i = 0; i < NUM_EDGES - 1; i++, flip /= 2) {
+			state.eo[i] = uint8_t(flip % 2);
+			flips += state.eo[i];
+		}
+		state.co[NUM_CORNERS - 1] = uint8_t((3 - twists % 3) % 3);
+		state.eo[NUM_EDGES - 1] = uint8_t(flips % 2);
+		return state;
+	}
+
+	/**
+		File of strictly increasing ranked states. Each one is written as varints: the corners minus those
+		of the state before, then the edges minus those before when the corners are the same or else the
+		edges themselves, then the last moves; about 8 bytes a state once layers get dense.
+	*/
+	class RunWriter {
+	public:
+		RunWriter(const string& path) :buffer(1 << 20), previous{ 0, 0, 0 }, count(0), bytes(0) {
+			out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+			out.open(path, ios::binary | ios::trunc);
+			if (!out) throw runtime_error("unable to write " + path);
+		}
+
+		void write(const RankedState& state) {
+			char encoded[32];
+			int n = 0;
+			n += encode(state.corners - previous.corners, encoded + n);
+			n += encode(state.corners == previous.corners ? state.edges - previous.edges : state.edges, encoded + n);
+			n += encode(state.lastMoves, encoded + n);
+			out.write(encoded, n);
+			previous = state;
+			count++;
+			bytes += n;
+		}
+
+		void close() {
+			out.close();
+			if (!out) throw runtime_error("unable to finish a run file, is the disk full?");
+		}
+
+		uint64_t states() const {
+			return count;
+		}
+
+		uint64_t size() const {
+			return bytes;
+		}
+
+	private:
+		static int encode(uint64_t value, char* to) {
+			int n = 0;
+			for (; value >= 0x80; value >>= 7) to[n++] = char(value | 0x80);
+			to[n++] = char(value);
+			return n;
+		}
+
+		vector<char> buffer;
+		ofstream out;
+		RankedState previous;
+		uint64_t count;
+		uint64_t bytes;
+	};
+
+	class RunReader {
+	public:
+		RunReader(const string& path) :buffer(1 << 16), previous{ 0, 0, 0 } {
+			in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+			in.open(path, ios::binary);
+			if (!in) throw runtime_error("unable to read " + path);
+		}
+
+		// false at the end of the file
+		bool next(RankedState& state) {
+			uint64_t corners;
+			if (!decode(corners)) return false;
+			uint64_t edges, lastMoves;
+			if (!decode(edges) || !decode(lastMoves)) throw runtime_error("run file ends in the middle of a state");
+			state.corners = previous.corners + corners;
+			state.edges = corners == 0 ? previous.edges + edges : edges;
+			state.lastMoves = uint16_t(lastMoves);
+			previous = state;
+			return true;
+		}
+
+	private:
+		bool decode(uint64_t& value) {
+			value = 0;
+			for (int shift = 0; ; shift += 7) {
+				int c = in.rdbuf()->sbumpc();
+				if (c == char_traits<char>::eof()) return false;
+				value |= uint64_t(c & 0x7F) << shift;
+				if (!(c & 0x80)) return true;
+			}
+		}
+
+		vector<char> buffer;
+		ifstream in;
+		RankedState previous;
+	};
+
+	/**
+		DepthEnumerator for layers that do not fit in memory. Layers live in run files in directory and
+		successors are collected in a buffer of memoryBudget bytes; every time it fills up it is sorted,
+		merged and spilled as a run. Duplicates are only removed afterwards, when the runs and the layer
+		two depths back are merged into the new layer in one sequential pass. No more than maxFanIn runs
+		are read at once, more are first merged maxFanIn at a time into longer runs until one pass can
+		take them all, so the open files stay below the limits of the C runtime (512 streams on MSVC)
+		and of the system. Only the buffer, a read buffer per merged run and the files of three layers
+		are needed at any time.
+	*/
+	class ExternalEnumerator {
+	public:
+		static const size_t MAX_FAN_IN = 128;
+
+		ExternalEnumerator(const CubeState& start, const string& directory, size_t memoryBudget = size_t(1) << 30, size_t maxFanIn = MAX_FAN_IN)
+			:directory(directory), capacity(max<size_t>(memoryBudget / sizeof(RankedState), 1024)), maxFanIn(max<size_t>(maxFanIn, 2)), currentDepth(0) {
+			RunWriter layer(layerPath(0));
+			layer.write(rankOf(start, 0));
+			layer.close();
+			layerStates = 1;
+			layerBytes = layer.size();
+		}
+
+		~ExternalEnumerator() {
+			remove(layerPath(currentDepth).c_str());
+			if (currentDepth > 0) remove(layerPath(currentDepth - 1).c_str());
+		}
+
+		int depth() const {
+			return currentDepth;
+		}
+
+		uint64_t generated() const {
+			return generatedCount;
+		}
+
+		// bytes the current layer takes on disk
+		uint64_t diskSize() const {
+			return layerBytes;
+		}
+
+		uint64_t runs() const {
+			return runCount;
+		}
+
+		// passes over the runs it took to make the current layer, 1 when they were merged at once
+		int passes() const {
+			return passCount;
+		}
+
+		template<typename F>
+		void forEach(F f) const {
+			RunReader layer(layerPath(currentDepth));
+			for (RankedState state; layer.next(state);) f(stateOf(state));
+		}
+
+		// moves to the next depth and returns how many states are there
+		uint64_t expand() {
+			const CubeState* faceMoves = faceMoveStates();
+			vector<string> runPaths;
+			vector<RankedState> buffer;
+			buffer.reserve(capacity);
+			generatedCount = 0;
+			try {
+				RunReader layer(layerPath(currentDepth));
+				for (RankedState ranked; layer.next(ranked);) {
+					uint16_t moves = followersOf(ranked.lastMoves);
+					if (buffer.size() + bitset<NUM_FACE_MOVES>(moves).count() > capacity) spill(buffer, runPaths);
+					CubeState state = stateOf(ranked);
+					for (int move = 0; move < NUM_FACE_MOVES; move++) {
+						if (moves >> move & 1) buffer.push_back(rankOf(state * faceMoves[move], uint16_t(1 << move)));
+					}
+					generatedCount += bitset<NUM_FACE_MOVES>(moves).count();
+				}
+				spill(buffer, runPaths);
+				runCount = runPaths.size();
+				vector<string> pending = runPaths;
+				for (passCount = 1; pending.size() > maxFanIn; passCount++) pending = mergePass(pending, runPaths);
+				merge(pending);
+			}
+			catch (...) {	// a full disk most likely, leave no runs or half a layer behind
+				for (const string& path : runPaths) remove(path.c_str());
+				remove(layerPath(currentDepth + 1).c_str());
+				throw;
+			}
+			for (const string& path : runPaths) remove(path.c_str());
+			if (currentDepth > 0) remove(layerPath(currentDepth - 1).c_str());
+			currentDepth++;
+			return layerStates;
+		}
+
+	private:
+		string layerPath(int depth) const {
+			return directory + "/layer-" + to_string(depth) + ".bin";
+		}
+
+		// sorts the buffer, merges its duplicates and writes it out as a run
+		void spill(vector<RankedState>& buffer, vector<string>& runPaths) {
+			if (buffer.empty()) return;
+			sort(buffer.begin(), buffer.end());
+			RunWriter run(newRun(runPaths));
+			for (size_t i = 0; i < buffer.size();) {
+				RankedState merged = buffer[i];
+				for (i++; i < buffer.size() && merged.sameState(buffer[i]); i++) merged.lastMoves |= buffer[i].lastMoves;
+				run.write(merged);
+			}
+			run.close();
+			buffer.clear();
+		}
+
+		string newRun(vector<string>& runPaths) const {
+			string path = directory + "/run-" + to_string(currentDepth + 1) + "-" + to_string(runPaths.size()) + ".bin";
+			runPaths.push_back(path);	// before writing, so a run that fails half way is cleaned up as well
+			return path;
+		}
+
+		// merges the pending runs maxFanIn at a time into longer ones, which are added to runPaths and returned
+		vector<string> mergePass(const vector<string>& pending, vector<string>& runPaths) {
+			vector<string> merged;
+			for (size_t first = 0; first < pending.size(); first += maxFanIn) {
+				vector<string> group(pending.begin() + first, pending.begin() + min(first + maxFanIn, pending.size()));
+				if (group.size() == 1) {
+					merged.push_back(group[0]);
+					continue;
+				}
+				merged.push_back(newRun(runPaths));
+				RunWriter run(merged.back());
+				mergeRuns(group, [&](const RankedState& state) { run.write(state); });
+				run.close();
+				for (const string& path : group) remove(path.c_str());
+			}
+			return merged;
+		}
+
+		// k way merge of the runs into the next layer, leaving out the states of the layer before this one
+		void merge(const vector<string>& runPaths) {
+			unique_ptr<RunReader> previous;
+			RankedState seen;
+			bool more = false;
+			if (currentDepth > 0) {
+				previous.reset(new RunReader(layerPath(currentDepth - 1)));
+				more = previous->next(seen);
+			}
+
+			RunWriter layer(layerPath(currentDepth + 1));
+			mergeRuns(runPaths, [&](const RankedState& merged) {
+				while (more && seen < merged) more = previous->next(seen);
+				if (more && seen.sameState(merged)) return;
+				layer.write(merged);
+			});
+			layer.close();
+			layerStates = layer.states();
+			layerBytes = layer.size();
+		}
+
+		// hands every state of the runs to f once and in order, with the last moves of its copies merged
+		template<typename F>
+		static void mergeRuns(const vector<string>& runPaths, F f) {
+			vector<unique_ptr<RunReader>> readers;
+			using Head = pair<RankedState, size_t>;
+			auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+			priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+			for (const string& path : runPaths) {
+				readers.emplace_back(new RunReader(path));
+				RankedState state;
+				if (readers.back()->next(state)) heads.push({ state, readers.size() - 1 });
+			}
+
+			while (!heads.empty()) {
+				RankedState merged = heads.top().first;
+				while (!heads.empty() && heads.top().first.sameState(merged)) {
+					Head head = heads.top();
+					heads.pop();
+					merged.lastMoves |= head.first.lastMoves;
+					if (readers[head.second]->next(head.first)) heads.push(head);
+				}
+				f(merged);
+			}
+		}
+
+		string directory;
+		size_t capacity;	// states the buffer holds
+		size_t maxFanIn;	// runs read at once
+		int currentDepth;
+		uint64_t layerStates;
+		uint64_t layerBytes;
+		uint64_t generatedCount = 0;
+		uint64_t runCount = 0;
+		int passCount = 0;
+	};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		Moves used to insert the corner and edge of the front right slot as a pair, with the white cross on
+		the down face. Each keeps the cross and the other three slots: turns of U and the four triggers
+		R U R', R U' R', F' U F and F' U' F.
+	*/
+	const vector<MoveSequence> F2L_GENERATORS = {
+		{ 4 },{ 10 },{ 1, 4, 7 },{ 1, 10, 7 },{ 6, 4, 0 },{ 6, 10, 0 }
+	};
+
+	// takes whatever sits in a slot up to the U layer, indexed by the slot's edge minus FR
+	const MoveSequence F2L_EXTRACT[4] = {
+		{ 1, 4, 7 },	// FR: R U R'
+		{ 9, 10, 3 },	// FL: L' U' L
+		{ 3, 4, 9 },	// BL: L U L'
+		{ 7, 10, 1 }	// BR: R' U' R
+	};
+
+	// corner slot sharing a slot with each middle layer edge FR, FL, BL, BR
+	const Corner F2L_CORNERS[4] = { DFR, DLF, DBL, DRB };
+
+	const int F2L_CASES = NUM_CORNERS * 3 * NUM_EDGES * 2;
+
+	// where the DFR corner and FR edge pieces are in state, and how they are turned
+	int f2lCase(const CubeState& state) {
+		int corner = 0, edge = 0;
+		for (int i = 0; i < NUM_CORNERS; i++) {
+			if (state.cp[i] == DFR) corner = i * 3 + state.co[i];
+		}
+		for (int i = 0; i < NUM_EDGES; i++) {
+			if (state.ep[i] == FR) edge = i * 2 + state.eo[i];
+		}
+		return corner * NUM_EDGES * 2 + edge;
+	}
+
+	// pieces of the front right pair sitting in one of the other three slots
+	int f2lStrays(const CubeState& state) {
+		int strays = 0;
+		for (int i = 1; i < 4; i++) {
+			strays += state.cp[F2L_CORNERS[i]] == DFR;
+			strays += state.ep[FR + i] == FR;
+		}
+		return strays;
+	}
+
+	/**
+		Moves that take the front right pair out of the other slots. Taking a slot out also drops a piece
+		of the U layer into it, so U is turned first when that piece would be the other half of the pair.
+	*/
+	MoveSequence f2lFreePair(CubeState state) {
+		const MoveSequence setups[4] = { {},{ 4 },{ 10 },{ 4, 4 } };
+		MoveSequence res;
+		for (int strays = f2lStrays(state); strays > 0; strays = f2lStrays(state)) {
+			for (int i = 1; i < 4 && f2lStrays(state) == strays; i++) {
+				if (state.cp[F2L_CORNERS[i]] != DFR && state.ep[FR + i] != FR) continue;
+				for (const MoveSequence& setup : setups) {
+					CubeState next = applySequence(applySequence(state, setup), F2L_EXTRACT[i]);
+					if (f2lStrays(next) < strays) {
+						res.insert(res.end(), setup.begin(), setup.end());
+						res.insert(res.end(), F2L_EXTRACT[i].begin(), F2L_EXTRACT[i].end());
+						state = next;
+						break;
+					}
+				}
+			}
+			if (f2lStrays(state) == strays) throw "unable to free f2l pair";
+		}
+		return res;
+	}
+
+	/**
+		For every case of the front right pair, the generator that starts the shortest way to insert it.
+		Cases that cannot come up with the pair out of the other slots are left at CASE_SOLVED.
+	*/
+	const uint8_t* f2lTable() {
+		static uint8_t next[F2L_CASES];
+		static bool initialized = [&]() {
+			buildCaseTable(F2L_GENERATORS, f2lCase, next, F2L_CASES);
+			return true;
+		}();
+		return next;
+	}
+}
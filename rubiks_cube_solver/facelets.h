@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include "model.h"
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		Facelet strings list the 9 facelets of the U, R, F, D, L and B faces in that order, each as the
+		letter of the face whose center has its color, so a solved cube reads
+		UUUUUUUUURRRRRRRRRFFFFFFFFFDDDDDDDDDLLLLLLLLLBBBBBBBBB. Each face is read row by row as seen
+		from outside: U with B at the top, D with F at the top and the side faces with U at the top.
+	*/
+	const int NUM_FACELETS = 54;
+	const char FACELET_FACES[] = "URFDLB";
+
+	// outward direction, direction of a column to the right and of a row down, for each face of a facelet string
+	const vec3 FACELET_AXES[NUM_FACES][3] = {
+		{ UP, RIGHT, FRONT },
+		{ RIGHT, BACK, DOWN },
+		{ FRONT, RIGHT, DOWN },
+		{ DOWN, RIGHT, BACK },
+		{ LEFT, FRONT, DOWN },
+		{ BACK, LEFT, DOWN }
+	};
+
+	// index into a facelet string of the facelet on cubie pos that faces direction
+	int faceletAt(const vec3 pos, const vec3 direction) {
+		for (int f = 0; f < NUM_FACES; f++) {
+			const vec3* axes = FACELET_AXES[f];
+			if (axes[0] != direction) continue;
+			int col = int(dot(pos, axes[1])) + 1;
+			int row = int(dot(pos, axes[2])) + 1;
+			return f * 9 + row * 3 + col;
+		}
+		throw "no facelet faces that direction";
+	}
+
+	// even permutations have parity 0
+	int parityOf(const uint8_t* p, int n) {
+		int parity = 0;
+		for (int i = 0; i < n; i++) {
+			for (int j = i + 1; j < n; j++) parity ^= p[j] < p[i];
+		}
+		return parity;
+	}
+
+	// throws unless state is one a real cube can be in, for states that come from outside
+	void checkState(const CubeState& state) {
+		bool seenCorners[NUM_CORNERS] = {}, seenEdges[NUM_EDGES] = {};
+		int twist = 0, flip = 0;
+		for (int i = 0; i < NUM_CORNERS; i++) {
+			if (state.cp[i] >= NUM_CORNERS || seenCorners[state.cp[i]]) throw "corner appears twice";
+			if (state.co[i] >= 3) throw "corner twist out of range";
+			seenCorners[state.cp[i]] = true;
+			twist += state.co[i];
+		}
+		for (int i = 0; i < NUM_EDGES; i++) {
+			if (state.ep[i] >= NUM_EDGES || seenEdges[state.ep[i]]) throw "edge appears twice";
+			if (state.eo[i] >= 2) throw "edge flip out of range";
+			seenEdges[state.ep[i]] = true;
+			flip += state.eo[i];
+		}
+		if (twist % 3 != 0) throw "corner twists do not add up, a corner is twisted";
+		if (flip % 2 != 0) throw "edge flips do not add up, an edge is flipped";
+		if (parityOf(state.cp, NUM_CORNERS) != parityOf(state.ep, NUM_EDGES)) throw "permutation parity is odd, two pieces are swapped";
+	}
+
+	/**
+		State of the cube a facelet string describes, with U up and F in front. Every piece has to show up
+		once with its colors in the right order, corner twists have to add up to a multiple of 3, edge flips
+		to a multiple of 2, and the corner and edge permutations must have the same parity; otherwise the
+		string cannot come from a real cube and is rejected. All checks take a fixed amount of work.
+	*/
+	CubeState parseFacelets(const string& facelets) {
+		if (facelets.size() != NUM_FACELETS) throw "facelet string must have 54 facelets";
+		int faces[NUM_FACELETS];
+		for (int i = 0; i < NUM_FACELETS; i++) {
+			const char* letter = strchr(FACELET_FACES, facelets[i]);
+			if (facelets[i] == 0 || letter == nullptr) throw "facelet must be one of U, R, F, D, L and B";
+			faces[i] = faceIndex(FACELET_AXES[letter - FACELET_FACES][0]);
+		}
+		for (int f = 0; f < NUM_FACES; f++) {
+			if (faces[f * 9 + 4] != faceIndex(FACELET_AXES[f][0])) throw "centers must be in the order U, R, F, D, L, B";
+		}
+
+		const int* slots = slotsByMask();
+		auto faceOf = [&](const vec3 pos, const vec3 direction) { return faces[faceletAt(pos, direction)]; };
+
+		CubeState state;
+		bool seenCorners[NUM_CORNERS] = {}, seenEdges[NUM_EDGES] = {};
+		for (int i = 0; i < NUM_CORNERS; i++) {
+			const vec3* sides = CORNER_FACELETS[i];
+			const vec3 pos = sides[0] + sides[1] + sides[2];
+			int face[3], mask = 0;
+			state.co[i] = 0;
+			for (int j = 0; j < 3; j++) {
+				face[j] = faceOf(pos, sides[j]);
+				mask |= 1 << face[j];
+				if (face[j] >= 4) state.co[i] = j;
+			}
+			int piece = slots[mask];
+			const vec3* home = CORNER_FACELETS[piece];
+			for (int j = 0; j < 3; j++) {
+				if (face[j] != faceIndex(home[(j + 3 - state.co[i]) % 3])) throw "corner colors do not belong to one corner";
+			}
+			if (seenCorners[piece]) throw "corner appears twice";
+			seenCorners[piece] = true;
+			state.cp[i] = piece;
+		}
+		for (int i = 0; i < NUM_EDGES; i++) {
+			const vec3* sides = EDGE_FACELETS[i];
+			const vec3 pos = sides[0] + sides[1];
+			int first = faceOf(pos, sides[0]), second = faceOf(pos, sides[1]);
+			int piece = slots[(1 << first) | (1 << second)];
+			const vec3* home = EDGE_FACELETS[piece];
+			state.eo[i] = first == faceIndex(home[0]) ? 0 : 1;
+			if (first != faceIndex(home[state.eo[i]]) || second != faceIndex(home[1 - state.eo[i]])) throw "edge colors do not belong to one edge";
+			if (seenEdges[piece]) throw "edge appears twice";
+			seenEdges[piece] = true;
+			state.ep[i] = piece;
+		}
+
+		checkState(state);
+		return state;
+	}
+
+	// facelet string of state, with U up and F in front
+	string faceletsOf(const CubeState& state) {
+		auto letterOf = [](const vec3 direction) {
+			for (int f = 0; f < NUM_FACES; f++) {
+				if (FACELET_AXES[f][0] == direction) return FACELET_FACES[f];
+			}
+			return '?';
+		};
+		string res(NUM_FACELETS, '?');
+		for (int f = 0; f < NUM_FACES; f++) res[f * 9 + 4] = FACELET_FACES[f];
+		for (int i = 0; i < NUM_CORNERS; i++) {
+			const vec3* sides = CORNER_FACELETS[i];
+			const vec3 pos = sides[0] + sides[1] + sides[2];
+			for (int j = 0; j < 3; j++) {
+				res[faceletAt(pos, sides[j])] = letterOf(CORNER_FACELETS[state.cp[i]][(j + 3 - state.co[i]) % 3]);
+			}
+		}
+		for (int i = 0; i < NUM_EDGES; i++) {
+			const vec3* sides = EDGE_FACELETS[i];
+			const vec3 pos = sides[0] + sides[1];
+			for (int j = 0; j < 2; j++) {
+				res[faceletAt(pos, sides[j])] = letterOf(EDGE_FACELETS[state.ep[i]][j ^ state.eo[i]]);
+			}
+		}
+		return res;
+	}
+
+	// puts rCube in the state of a facelet string, U up and F in front
+	void loadFacelets(RubiksCube& rCube, const string& facelets) {
+		Snapshot snapshot;
+		snapshot.state = parseFacelets(facelets);
+		snapshot.up = uint8_t(faceIndex(UP));
+		snapshot.front = uint8_t(faceIndex(FRONT));
+		restore(rCube, snapshot);
+	}
+}
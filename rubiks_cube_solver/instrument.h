@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+#ifdef RUBIKS_INSTRUMENT
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+/**
+	Call counters for the model queries, compiled in only when RUBIKS_INSTRUMENT is defined; otherwise
+	RUBIKS_QUERY and RUBIKS_STAGE expand to nothing. Every query counts its calls, the allocations made
+	during them and the cycles spent in them, per solver stage, on counters owned by the calling thread.
+	Queries that call other queries count those too. reportCounters prints the totals at any time and
+	they are printed to cerr at exit.
+*/
+namespace rubiks {
+
+	enum Query { QUERY_FIND, QUERY_CUBE_AT, QUERY_CENTER, QUERY_FACE_GET, QUERY_FACE_CENTER, QUERY_COLOR_FOR, QUERY_IS_IN_PLACE, NUM_QUERIES };
+
+	const char* const QUERY_NAMES[NUM_QUERIES] = {
+		"RubiksCube::find", "RubiksCube::cubeAt", "RubiksCube::center", "Face::get", "Face::center", "Cube::colorFor", "RubiksCube::isInPlace"
+	};
+
+	enum Stage { STAGE_OTHER, STAGE_DAISY, STAGE_WHITE_CROSS, STAGE_FIRST_TWO_LAYERS, STAGE_LAST_LAYER, NUM_STAGES };
+
+	const char* const STAGE_NAMES[NUM_STAGES] = { "other", "daisy", "white cross", "first two layers", "last layer" };
+
+#ifdef RUBIKS_INSTRUMENT
+
+	// counted by operator new below, a plain thread local so counting cannot allocate
+	thread_local uint64_t threadAllocations = 0;
+
+	inline uint64_t cycleCount() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	// only the owning thread writes, so a relaxed load and store is enough and avoids a locked add
+	struct Counter {
+		std::atomic<uint64_t> value{ 0 };
+
+		void add(uint64_t amount) {
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		uint64_t get() const {
+			return value.load(std::memory_order_relaxed);
+		}
+	};
+
+	struct QueryCounters {
+		Counter calls;
+		Counter allocations;
+		Counter cycles;
+	};
+
+	struct ThreadCounters {
+		QueryCounters queries[NUM_STAGES][NUM_QUERIES];
+		Stage stage = STAGE_OTHER;
+	};
+
+	// counters of every thread that ever made a query, never freed so the report at exit can read them
+	struct CounterRegistry {
+		std::mutex lock;
+		std::vector<ThreadCounters*> threads;
+	};
+
+	CounterRegistry& counterRegistry() {
+		static CounterRegistry* registry = new CounterRegistry;
+		return *registry;
+	}
+
+	ThreadCounters& threadCounters() {
+		thread_local ThreadCounters* counters = []() {
+			ThreadCounters* counters = new ThreadCounters;
+			CounterRegistry& registry = counterRegistry();
+			std::lock_guard<std::mutex> guard(registry.lock);
+			registry.threads.push_back(counters);
+			return counters;
+		}();
+		return *counters;
+	}
+
+	class QueryScope {
+	public:
+		QueryScope(Query query) :query(query), allocations(threadAllocations), start(cycleCount()) {}
+
+		~QueryScope() {
+			uint64_t end = cycleCount();
+			ThreadCounters& counters = threadCounters();
+			QueryCounters& q = counters.queries[counters.stage][query];
+			q.calls.add(1);
+			q.allocations.add(threadAllocations - allocations);
+			q.cycles.add(end - start);
+		}
+
+	private:
+		Query query;
+		uint64_t allocations;
+		uint64_t start;
+	};
+
+	class StageScope {
+	public:
+		StageScope(Stage stage) :previous(threadCounters().stage) {
+			threadCounters().stage = stage;
+		}
+
+		~StageScope() {
+			threadCounters().stage = previous;
+		}
+
+	private:
+		Stage previous;
+	};
+
+	// totals over all threads, exact once they are done and close while they still run
+	void reportCounters(std::ostream& out) {
+		CounterRegistry& registry = counterRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		out << std::left << std::setw(18) << "stage" << std::setw(24) << "query" << std::right
+			<< std::setw(14) << "calls" << std::setw(14) << "allocations" << std::setw(16) << "cycles" << std::setw(10) << "per call" << std::endl;
+		for (int s = 0; s < NUM_STAGES; s++) {
+			for (int q = 0; q < NUM_QUERIES; q++) {
+				uint64_t calls = 0, allocations = 0, cycles = 0;
+				for (ThreadCounters* counters : registry.threads) {
+					calls += counters->queries[s][q].calls.get();
+					allocations += counters->queries[s][q].allocations.get();
+					cycles += counters->queries[s][q].cycles.get();
+				}
+				if (calls == 0) continue;
+				out << std::left << std::setw(18) << STAGE_NAMES[s] << std::setw(24) << QUERY_NAMES[q] << std::right
+					<< std::setw(14) << calls << std::setw(14) << allocations << std::setw(16) << cycles << std::setw(10) << cycles / calls << std::endl;
+			}
+		}
+	}
+
+	void resetCounters() {
+		CounterRegistry& registry = counterRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		for (ThreadCounters* counters : registry.threads) {
+			for (auto& stage : counters->queries) {
+				for (QueryCounters& q : stage) {
+					q.calls.value = 0;
+					q.allocations.value = 0;
+					q.cycles.value = 0;
+				}
+			}
+		}
+	}
+
+	struct CounterReportAtExit {
+		~CounterReportAtExit() {
+			if (!counterRegistry().threads.empty()) reportCounters(std::cerr);
+		}
+	} counterReportAtExit;
+
+#define RUBIKS_QUERY(query) rubiks::QueryScope rubiksQueryScope(query)
+#define RUBIKS_STAGE(stage) rubiks::StageScope rubiksStageScope(stage)
+
+#else
+
+	void reportCounters(std::ostream& out) {
+		out << "query counters are disabled, build with RUBIKS_INSTRUMENT defined" << std::endl;
+	}
+
+	void resetCounters() {}
+
+#define RUBIKS_QUERY(query)
+#define RUBIKS_STAGE(stage)
+
+#endif
+}
+
+#ifdef RUBIKS_INSTRUMENT
+
+void* operator new(size_t size) {
+	rubiks::threadAllocations++;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+#endif
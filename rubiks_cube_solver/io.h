@@ -37,7 +37,7 @@ namespace rubiks {
 		if (!fout) {
 			throw std::runtime_error("unable to open file cube.rubiks");
 		}
-		fout.write((char*)&rCube, sizeof RubiksCube);
+		fout.write((char*)&rCube, sizeof(RubiksCube));
 		fout.close();
 	}
 
@@ -46,7 +46,7 @@ namespace rubiks {
 		if (!fin) {
 			throw std::runtime_error("unable to open file cube.rubiks");
 		}
-		fin.read((char*)&rCube, sizeof RubiksCube);
+		fin.read((char*)&rCube, sizeof(RubiksCube));
 		for_each(begin(rCube.cubes), end(rCube.cubes), [&](Cube& c) { c.parent = &rCube; });
 	}
 }
\ No newline at end of file
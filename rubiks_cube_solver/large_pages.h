@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fstream>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace rubiks {
+
+	enum PageSize { SMALL_PAGES, HUGE_PAGES_2MB, HUGE_PAGES_1GB };
+
+	// where the pages of a table go on a machine with more than one memory node
+	enum NumaPlacement { NUMA_DEFAULT, NUMA_INTERLEAVE, NUMA_REPLICATE };
+
+	const int ANY_NODE = -1;
+	const int INTERLEAVED = -2;
+
+	const size_t SMALL_PAGE = size_t(4) << 10;
+	const size_t HUGE_PAGE_2MB = size_t(2) << 20;
+	const size_t HUGE_PAGE_1GB = size_t(1) << 30;
+
+	// node numbers go from 0 to numaNodes() - 1; 1 where there is no NUMA
+	int numaNodes() {
+		static int nodes = []() {
+#ifdef _WIN32
+			ULONG highest = 0;
+			return GetNumaHighestNodeNumber(&highest) ? int(highest) + 1 : 1;
+#else
+			ifstream online("/sys/devices/system/node/online");
+			string ranges;
+			if (!(online >> ranges)) return 1;
+			size_t last = ranges.find_last_of(",-");
+			return atoi(ranges.c_str() + (last == string::npos ? 0 : last + 1)) + 1;
+#endif
+		}();
+		return nodes;
+	}
+
+	int& threadNode() {
+		static thread_local int node = 0;
+		return node;
+	}
+
+	// node the calling thread was pinned to, 0 for threads that were not
+	int currentNode() {
+		return threadNode();
+	}
+
+	/**
+		Runs the calling thread only on the processors of node from now on, so the memory it allocates and
+		the replicas it picks by currentNode() are local to it. False when that is not possible.
+	*/
+	bool pinToNode(int node) {
+		if (node < 0 || node >= numaNodes()) return false;
+#ifdef _WIN32
+		GROUP_AFFINITY affinity = {};
+		if (!GetNumaNodeProcessorMaskEx(USHORT(node), &affinity) || !SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) return false;
+#else
+		ifstream in("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+		string list;
+		if (!(in >> list)) return false;
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		for (size_t at = 0; at < list.size();) {	// ranges like 0-15,32-47
+			char* end;
+			long first = strtol(list.c_str() + at, &end, 10), last = first;
+			if (*end == '-') last = strtol(end + 1, &end, 10);
+			for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) CPU_SET(int(cpu), &cpus);
+			at = size_t(end - list.c_str()) + 1;
+		}
+		if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) return false;
+#endif
+		threadNode() = node;
+		return true;
+	}
+
+	/**
+		Asks for bytes at p to be backed by transparent huge pages, which Linux only does by itself for
+		memory it was told about when it is in madvise mode. Best before the pages are first touched.
+		Nothing happens elsewhere, or for less than a huge page.
+	*/
+	void adviseHugePages(const void* p, size_t bytes) {
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+		if (bytes < HUGE_PAGE_2MB) return;
+		uintptr_t start = (reinterpret_cast<uintptr_t>(p) + SMALL_PAGE - 1) & ~(SMALL_PAGE - 1);
+		uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) & ~(SMALL_PAGE - 1);
+		if (end > start) madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE);
+#endif
+	}
+
+	/**
+		Enables SeLockMemoryPrivilege in the token of the process, which Windows wants for large pages on top
+		of the lock pages in memory right of the account. Tried once; false when the account lacks the right.
+		Linux needs nothing of the kind.
+	*/
+	bool enableLargePages() {
+#ifdef _WIN32
+		static bool enabled = []() {
+			HANDLE token;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+			TOKEN_PRIVILEGES privileges = {};
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			// AdjustTokenPrivileges succeeds without the right too, and only tells through the last error
+			bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)
+				&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+			CloseHandle(token);
+			return ok;
+		}();
+		return enabled;
+#else
+		return true;
+#endif
+	}
+
+	/**
+		Memory for a table that is read at random, in pages of the size asked for where the system has them
+		and on node (ANY_NODE, or INTERLEAVED to spread the pages over all nodes). Explicit huge pages need
+		a pool reserved by the administrator on Linux (vm.nr_hugepages) and the lock pages in memory right
+		on Windows, which enableLargePages turns on for the process; without them Linux falls back to
+		transparent huge pages and then to small pages, and pageSize() tells what was had. Windows has no 1 GB pages through VirtualAlloc and no interleaving,
+		and uses 2 MB pages and the default node for those.
+	*/
+	class PlacedMemory {
+	public:
+		PlacedMemory(size_t bytes, PageSize pages, int node = ANY_NODE) :base(nullptr), length(bytes), page(SMALL_PAGE) {
+#ifdef _WIN32
+			DWORD preferred = node >= 0 ? DWORD(node) : NUMA_NO_PREFERRED_NODE;
+			size_t large = GetLargePageMinimum();
+			noPrivilege = pages != SMALL_PAGES && large > 0 && !enableLargePages();
+			if (pages != SMALL_PAGES && large > 0 && !noPrivilege) {
+				length = roundUp(bytes, large);
+				base = VirtualAllocExNuma(GetCurrentProcess(), nullptr, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, preferred);
+				if (base) page = large;
+			}
+			if (!base) {
+				length = roundUp(bytes, SMALL_PAGE);
+				base = VirtualAllocExNuma(GetCurrentProcess(), nullptr, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, preferred);
+			}
+			if (!base) throw "unable to allocate memory for a table";
+#else
+			if (pages == HUGE_PAGES_1GB) mapHuge(bytes, HUGE_PAGE_1GB, 30);
+			if (!base && pages != SMALL_PAGES) mapHuge(bytes, HUGE_PAGE_2MB, 21);
+			if (!base) {
+				// aligned to 2 MB so transparent huge pages can back all of it
+				size_t align = pages == SMALL_PAGES ? SMALL_PAGE : HUGE_PAGE_2MB;
+				length = roundUp(bytes, align);
+				void* mapped = mmap(nullptr, length + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (mapped == MAP_FAILED) throw "unable to allocate memory for a table";
+				uintptr_t start = roundUp(reinterpret_cast<uintptr_t>(mapped), align);
+				size_t before = start - reinterpret_cast<uintptr_t>(mapped);
+				if (before) munmap(mapped, before);
+				if (align - before) munmap(reinterpret_cast<void*>(start + length), align - before);
+				base = reinterpret_cast<void*>(start);
+				if (pages != SMALL_PAGES) {
+					adviseHugePages(base, length);
+					transparent = true;
+				}
+			}
+			bind(node);
+#endif
+		}
+
+		~PlacedMemory() {
+#ifdef _WIN32
+			VirtualFree(base, 0, MEM_RELEASE);
+#else
+			munmap(base, length);
+#endif
+		}
+
+		uint8_t* data() const {
+			return static_cast<uint8_t*>(base);
+		}
+
+		size_t size() const {
+			return length;
+		}
+
+		// size of the pages that were had; transparent huge pages count as small, the kernel may or may not use them
+		size_t pageSize() const {
+			return page;
+		}
+
+		string describe() const {
+			if (page == HUGE_PAGE_1GB) return "1 GB pages";
+			if (page >= HUGE_PAGE_2MB) return to_string(page >> 20) + " MB pages";
+			if (noPrivilege) return "small pages, SeLockMemoryPrivilege could not be enabled for large ones";
+			return transparent ? "transparent huge pages" : "small pages";
+		}
+
+	private:
+		PlacedMemory(const PlacedMemory&) = delete;
+		PlacedMemory& operator=(const PlacedMemory&) = delete;
+
+		static size_t roundUp(size_t n, size_t to) {
+			return (n + to - 1) / to * to;
+		}
+
+#ifndef _WIN32
+		void mapHuge(size_t bytes, size_t size, int shift) {
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+			void* mapped = mmap(nullptr, roundUp(bytes, size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+			if (mapped == MAP_FAILED) return;
+			base = mapped;
+			length = roundUp(bytes, size);
+			page = size;
+#endif
+		}
+
+		// mbind without libnuma, before any page is touched so they are all allocated where they belong
+		void bind(int node) {
+#ifdef SYS_mbind
+			const int MPOL_BIND = 2, MPOL_INTERLEAVE = 3;
+			int nodes = numaNodes();
+			if (nodes < 2 || node == ANY_NODE || node >= nodes) return;
+			const int BITS = int(sizeof(unsigned long) * 8);
+			vector<unsigned long> mask(nodes / BITS + 1, 0);
+			if (node == INTERLEAVED) {
+				for (int n = 0; n < nodes; n++) mask[n / BITS] |= 1UL << (n % BITS);
+			}
+			else {
+				mask[node / BITS] |= 1UL << (node % BITS);
+			}
+			syscall(SYS_mbind, base, length, node == INTERLEAVED ? MPOL_INTERLEAVE : MPOL_BIND, mask.data(), mask.size() * BITS, 0);
+#endif
+		}
+#endif
+
+		void* base;
+		size_t length;
+		size_t page;
+		bool transparent = false;
+		bool noPrivilege = false;	// large pages were asked for on Windows, but the process may not lock memory
+	};
+}
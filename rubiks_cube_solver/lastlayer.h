@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		Algorithms for the last layer, with the first two layers solved and the last layer on U. OLL
+		orients the last layer pieces, PLL then permutes them; turns of U between and after the algorithms
+		are generators as well.
+	*/
+	const vector<MoveSequence> OLL_GENERATORS = {
+		{ 4 },{ 10 },{ 4, 4 },
+		{ 1, 4, 7, 4, 1, 4, 4, 7 },		// Sune: R U R' U R U2 R'
+		{ 1, 4, 4, 7, 10, 1, 10, 7 },	// anti Sune: R U2 R' U' R U' R'
+		{ 0, 1, 4, 7, 10, 6 },			// F R U R' U' F'
+		{ 0, 4, 1, 10, 7, 6 }			// F U R U' R' F'
+	};
+
+	const vector<MoveSequence> PLL_GENERATORS = {
+		{ 4 },{ 10 },{ 4, 4 },
+		{ 1, 4, 7, 10, 7, 0, 1, 1, 10, 7, 10, 1, 4, 7, 6 },		// T: R U R' U' R' F R2 U' R' U' R U R' F'
+		{ 1, 10, 1, 4, 1, 4, 1, 10, 7, 10, 1, 1 },				// Ua: R U' R U R U R U' R' U' R2
+		{ 1, 1, 4, 1, 4, 7, 10, 7, 10, 7, 4, 7 },				// Ub: R2 U R U R' U' R' U' R' U R'
+		{ 1, 4, 7, 6, 1, 4, 7, 10, 7, 0, 1, 1, 10, 7, 10 },		// Jb: R U R' F' R U R' U' R' F R2 U' R' U'
+		{ 0, 1, 10, 7, 10, 1, 4, 7, 6, 1, 4, 7, 10, 7, 0, 1, 6 }	// Y: F R U' R' U' R U R' F' R U R' U' R' F R F'
+	};
+
+	const int OLL_CASES = 81 * 16;
+	const int PLL_CASES = 24 * 24;
+
+	// twists of the U corners in base 3 next to flips of the U edges in base 2
+	int ollCase(const CubeState& state) {
+		int corners = 0, edges = 0;
+		for (int i = UBR; i >= URF; i--) corners = corners * 3 + state.co[i];
+		for (int i = UB; i >= UR; i--) edges = edges * 2 + state.eo[i];
+		return corners * 16 + edges;
+	}
+
+	// rank of a permutation of 4
+	int permutationIndex(const uint8_t* p) {
+		int index = 0;
+		for (int i = 0; i < 4; i++) {
+			int smaller = 0;
+			for (int j = i + 1; j < 4; j++) smaller += p[j] < p[i];
+			index = index * (4 - i) + smaller;
+		}
+		return index;
+	}
+
+	int pllCase(const CubeState& state) {
+		return permutationIndex(state.cp + URF) * 24 + permutationIndex(state.ep + UR);
+	}
+
+	// true when sequence leaves the first two layers alone, and the last layer orientation too if it is a PLL
+	bool keepsFirstTwoLayers(const MoveSequence& sequence, bool keepOrientation) {
+		CubeState state = applySequence(CubeState::solved(), sequence);
+		for (int i = DFR; i <= DRB; i++) {
+			if (state.cp[i] != i || state.co[i] != 0) return false;
+		}
+		for (int i = DR; i <= BR; i++) {
+			if (state.ep[i] != i || state.eo[i] != 0) return false;
+		}
+		return !keepOrientation || ollCase(state) == ollCase(CubeState::solved());
+	}
+
+	// case table of a last layer stage, and the algorithm it gives for each case
+	struct LastLayerStage {
+		vector<uint8_t> next;
+		vector<MoveSequence> algorithms;
+	};
+
+	LastLayerStage buildStage(const vector<MoveSequence>& generators, int(*caseOf)(const CubeState&), int size, bool keepOrientation) {
+		for (const MoveSequence& g : generators) {
+			if (!keepsFirstTwoLayers(g, keepOrientation)) throw keepOrientation ? "PLL algorithm breaks the first two layers or orientation" : "OLL algorithm breaks the first two layers";
+		}
+		LastLayerStage stage;
+		stage.next.resize(size);
+		buildCaseTable(generators, caseOf, stage.next.data(), size, &stage.algorithms);
+		return stage;
+	}
+
+	const LastLayerStage& ollStage() {
+		static LastLayerStage stage = buildStage(OLL_GENERATORS, ollCase, OLL_CASES, false);
+		return stage;
+	}
+
+	const LastLayerStage& pllStage() {
+		static LastLayerStage stage = buildStage(PLL_GENERATORS, pllCase, PLL_CASES, true);
+		return stage;
+	}
+
+	const uint8_t* ollTable() {
+		return ollStage().next.data();
+	}
+
+	const uint8_t* pllTable() {
+		return pllStage().next.data();
+	}
+
+	/**
+		One algorithm for every orientation case, and one for every permutation case with the turns of U
+		before and after it. They are the shortest chains of the generators, joined into a single sequence
+		when the tables are built.
+	*/
+	const vector<MoveSequence>& ollAlgorithms() {
+		return ollStage().algorithms;
+	}
+
+	const vector<MoveSequence>& pllAlgorithms() {
+		return pllStage().algorithms;
+	}
+
+	/**
+		Moves solving the last layer of state, which must have the first two layers solved: the algorithm of
+		its orientation case, then the one of the permutation case that leaves.
+	*/
+	MoveSequence lastLayerSolution(const CubeState& state) {
+		auto algorithmOf = [](const LastLayerStage& stage, int c, int solved) -> const MoveSequence& {
+			if (c != solved && stage.next[c] == CASE_SOLVED) throw "no last layer case for cube";
+			return stage.algorithms[c];
+		};
+		const CubeState solved = CubeState::solved();
+		MoveSequence res = algorithmOf(ollStage(), ollCase(state), ollCase(solved));
+		CubeState oriented = applySequence(state, res);
+		appendMerged(res, algorithmOf(pllStage(), pllCase(oriented), pllCase(solved)));
+		return res;
+	}
+}
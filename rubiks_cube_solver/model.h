@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <initializer_list>
 #include "util.h"
+#include "instrument.h"
 using namespace std;
 using namespace glm;
 
@@ -144,6 +145,7 @@ namespace rubiks {
 		}
 
 		vector<reference_wrapper<Cube>> find(function<bool(Cube&)> predicate) {
+			RUBIKS_QUERY(QUERY_FIND);
 			vector<reference_wrapper<Cube>> res;
 			for (Cube& c : cubes) {
 				if (predicate(c)) {
@@ -166,10 +168,12 @@ namespace rubiks {
 		}
 
 		const Cube& center(const vec3 color) {
+			RUBIKS_QUERY(QUERY_CENTER);
 			return find([&](Cube& c) { return c.type == CENTER && c.zc == color; }).front();
 		}
 
 		 Cube& cubeAt(const vec3 pos) {
+			RUBIKS_QUERY(QUERY_CUBE_AT);
 			vector<reference_wrapper<Cube>> res = find([&](Cube& c) { return c.pos == pos; });
 			if (res.empty()) throw "No Cube found at pos: [" + to_string(pos.x) + ", " + to_string(pos.y) + ", " + to_string(pos.z) + "]";
 			return res.front();
@@ -217,6 +221,7 @@ namespace rubiks {
 		}
 
 		vector<reference_wrapper<Cube>> get(RubiksCube& rCube) const {
+			RUBIKS_QUERY(QUERY_FACE_GET);
 			vector<reference_wrapper<Cube>> res;
 			for (int i = 0; i < NUM_CUBES; i++) {
 				Cube& cube = rCube.cubes[i];
@@ -228,6 +233,7 @@ namespace rubiks {
 		}
 
 		vector<reference_wrapper<Cube>> get(vector<reference_wrapper<Cube>> cubes) const {
+			RUBIKS_QUERY(QUERY_FACE_GET);
 			vector<reference_wrapper<Cube>> res;
 			for (int i = 0; i < cubes.size(); i++) {
 				Cube& cube = cubes[i];
@@ -258,6 +264,7 @@ namespace rubiks {
 		}
 
 		Cube& center(RubiksCube& cube) const {
+			RUBIKS_QUERY(QUERY_FACE_CENTER);
 			return cube.find([&](Cube& c) { return c.type == CENTER && isIn(c.fz); }).front().get();
 		}
 
@@ -273,6 +280,7 @@ namespace rubiks {
 	};
 
 	vec3 Cube::colorFor(const Face& face) const{
+		RUBIKS_QUERY(QUERY_COLOR_FOR);
 		if (fx == face.direction) {
 			return xc;
 		}
@@ -355,6 +363,7 @@ namespace rubiks {
 	}
 
 	bool RubiksCube::isInPlace(Cube& cube, bool strict) {
+		RUBIKS_QUERY(QUERY_IS_IN_PLACE);
 		if (cube.type == CENTER) return true;
 		if (strict) {
 			auto face = faceFor(cube.fx);
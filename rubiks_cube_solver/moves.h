@@ -4,9 +4,9 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <cstdint>
 #include <iostream>
 #include <algorithm>
-#include <queue>
 #include "model.h"
 #include "util.h"
 #include <iterator>
@@ -53,14 +53,8 @@ namespace rubiks {
 	public:
 		FaceMove(const Face& f, const float ra, const string n) :face(f), Move(n, { f.direction, ra }) {}
 
-		virtual void applyTo(RubiksCube& cube) override {
-			applyTo(cube, rotation.axis, rotation.amout);
-		}
-
-
-
-		virtual void applyTo(RubiksCube& rCube, vec3 axis, float amount) {
-			mat4 m = rotate(mat4(1), radians(amount), axis);
+		virtual void applyTo(RubiksCube& rCube) override {
+			mat4 m = rotate(mat4(1), radians(rotation.amout), rotation.axis);
 			mat3 nm = mat3(m);
 			for (int i = 0; i < NUM_CUBES; i++) {
 				auto& cube = rCube.cubes[i];
@@ -136,12 +130,8 @@ namespace rubiks {
 	public:
 		Spin(const Rotation r, const string n) :Move(n, r) {}
 
-		virtual void applyTo(RubiksCube& cube) override {
-			applyTo(cube, rotation.axis, rotation.amout);
-		}
-
-		virtual void applyTo(RubiksCube& rCube, vec3 axis, float amount) {
-			mat4 m = rotate(mat4(1), radians(amount), axis);
+		virtual void applyTo(RubiksCube& rCube) override {
+			mat4 m = rotate(mat4(1), radians(rotation.amout), rotation.axis);
 			mat3 nm = mat3(m);
 			for (int i = 0; i < NUM_CUBES; i++) {
 				auto& cube = rCube.cubes[i];
@@ -194,57 +184,156 @@ namespace rubiks {
 	static Spin SPIN_UP = Spin({ { 1, 0, 0 }, -90.f }, "spin up");
 	static Spin SPIN_DOWN = Spin({ { 1, 0, 0 }, 90.f }, "spin down");
 
-	static vector<Move*> RArg{ &R, &U, &_R, &_U };
-	static vector<Move*> LArg{ &_L, &_U, &L, &U };
 
-	void apply(vector<Move*> moves, RubiksCube& cube, queue<Move*>& appliedMoves, int iterations) {
-		for (int i = 0; i < iterations; i++) {
-			for_each(moves.begin(), moves.end(), [&](Move* m) {
-				m->applyTo(cube);
-				appliedMoves.push(m);
-			});
+	const int NUM_MOVES = 28;
+
+	static Move* allMoves[NUM_MOVES] = {
+		&F, &R, &B, &L, &U, &D, &_F, &_R, &_B, &_L, &_U, &_D, &SPIN_LEFT, &SPIN_RIGHT, &SPIN_UP, &SPIN_DOWN,
+		&f, &r, &b, &l, &u, &d, &_f, &_r, &_b, &_l, &_u, &_d
+	};
+
+	/**
+		Moves are passed around as their index into allMoves, the Move objects are only needed to animate
+		and apply them to the geometric model.
+	*/
+	using MoveCode = uint8_t;
+
+	// code of every move by name, in the order of allMoves; PRIME turns counterclockwise, WIDE turns two layers
+	enum : MoveCode {
+		CODE_F, CODE_R, CODE_B, CODE_L, CODE_U, CODE_D,
+		CODE_F_PRIME, CODE_R_PRIME, CODE_B_PRIME, CODE_L_PRIME, CODE_U_PRIME, CODE_D_PRIME,
+		CODE_SPIN_LEFT, CODE_SPIN_RIGHT, CODE_SPIN_UP, CODE_SPIN_DOWN,
+		CODE_WIDE_F, CODE_WIDE_R, CODE_WIDE_B, CODE_WIDE_L, CODE_WIDE_U, CODE_WIDE_D,
+		CODE_WIDE_F_PRIME, CODE_WIDE_R_PRIME, CODE_WIDE_B_PRIME, CODE_WIDE_L_PRIME, CODE_WIDE_U_PRIME, CODE_WIDE_D_PRIME
+	};
+
+	enum MoveKind : uint8_t { FACE_TURN, WIDE_TURN, CUBE_SPIN };
+
+	// face turned (F, R, B, L, U, D, the U and R turns stand for y and x spins), quarter turns clockwise and the code undoing it
+	struct MoveInfo {
+		const char* name;
+		MoveKind kind;
+		uint8_t face;
+		uint8_t turns;
+		MoveCode inverse;
+	};
+
+	const MoveInfo MOVE_INFO[NUM_MOVES] = {
+		{ "F", FACE_TURN, 0, 1, 6 },{ "R", FACE_TURN, 1, 1, 7 },{ "B", FACE_TURN, 2, 1, 8 },
+		{ "L", FACE_TURN, 3, 1, 9 },{ "U", FACE_TURN, 4, 1, 10 },{ "D", FACE_TURN, 5, 1, 11 },
+		{ "-F", FACE_TURN, 0, 3, 0 },{ "-R", FACE_TURN, 1, 3, 1 },{ "-B", FACE_TURN, 2, 3, 2 },
+		{ "-L", FACE_TURN, 3, 3, 3 },{ "-U", FACE_TURN, 4, 3, 4 },{ "-D", FACE_TURN, 5, 3, 5 },
+		{ "spin left", CUBE_SPIN, 4, 3, 13 },{ "spin right", CUBE_SPIN, 4, 1, 12 },
+		{ "spin up", CUBE_SPIN, 1, 1, 15 },{ "spin down", CUBE_SPIN, 1, 3, 14 },
+		{ "f", WIDE_TURN, 0, 1, 22 },{ "r", WIDE_TURN, 1, 1, 23 },{ "b", WIDE_TURN, 2, 1, 24 },
+		{ "l", WIDE_TURN, 3, 1, 25 },{ "u", WIDE_TURN, 4, 1, 26 },{ "d", WIDE_TURN, 5, 1, 27 },
+		{ "-f", WIDE_TURN, 0, 3, 16 },{ "-r", WIDE_TURN, 1, 3, 17 },{ "-b", WIDE_TURN, 2, 3, 18 },
+		{ "-l", WIDE_TURN, 3, 3, 19 },{ "-u", WIDE_TURN, 4, 3, 20 },{ "-d", WIDE_TURN, 5, 3, 21 }
+	};
+
+	MoveCode codeOf(const Move& move) {
+		for (int i = 0; i < NUM_MOVES; i++) {
+			if (allMoves[i] == &move) return MoveCode(i);
 		}
+		throw "move has no code";
 	}
 
-	void add(vector<Move*> moves, queue<Move*>& movesOut) {
-		foreach(moves, [&](Move* m) { movesOut.push(m); });
-	}
 
-	auto R_U_RI_UI = bind(apply, RArg, _1, _2, _3);
-	auto LI_UI_L_U = bind(apply, LArg, _1, _2, _3);
+	/**
+		Quarter turn of v about axis Axis (0 for x, 1 for y, 2 for z), Sin being the sine of the angle.
+		Coordinates and facelet directions on the model are whole numbers, so it only swaps and negates.
+	*/
+	template<int Axis, int Sin>
+	inline void quarterTurn(vec3& v) {
+		const int a = (Axis + 1) % 3, b = (Axis + 2) % 3;
+		float va = v[a];
+		v[a] = -Sin * v[b];
+		v[b] = Sin * va;
+	}
 
+	/**
+		Turns the Depth layers on the Sign side of axis Axis: 1 is a face move, 2 a wide move and 3 spins
+		the whole cube.
+	*/
+	template<int Axis, int Sign, int Sin, int Depth>
+	void turnLayers(RubiksCube& rCube) {
+		for (int i = 0; i < NUM_CUBES; i++) {
+			Cube& cube = rCube.cubes[i];
+			if (int(cube.pos[Axis]) * Sign < 2 - Depth) continue;
+			quarterTurn<Axis, Sin>(cube.pos);
+			quarterTurn<Axis, Sin>(cube.fx);
+			quarterTurn<Axis, Sin>(cube.fy);
+			quarterTurn<Axis, Sin>(cube.fz);
+		}
+	}
 
-	static Move* allMoves[22] = {
-		&F, &R, &B, &L, &U, &D, &_F, &_R, &_B, &_L, &_U, &_D, &SPIN_LEFT, &SPIN_RIGHT, &SPIN_UP, &SPIN_DOWN,
-		&f, &r, &b, &l, &u, &d
-	};
+	/**
+		Applies the move with code to cube without going through the Move objects; the switch compiles to
+		a jump table into kernels the compiler can unroll. A face turned clockwise, seen from outside,
+		is a rotation by -90 degrees about its direction.
+	*/
+	void applyMove(RubiksCube& cube, MoveCode code) {
+		switch (code) {
+		case 0: turnLayers<2, 1, -1, 1>(cube); break;	// F
+		case 1: turnLayers<0, 1, -1, 1>(cube); break;	// R
+		case 2: turnLayers<2, -1, 1, 1>(cube); break;	// B
+		case 3: turnLayers<0, -1, 1, 1>(cube); break;	// L
+		case 4: turnLayers<1, 1, -1, 1>(cube); break;	// U
+		case 5: turnLayers<1, -1, 1, 1>(cube); break;	// D
+		case 6: turnLayers<2, 1, 1, 1>(cube); break;
+		case 7: turnLayers<0, 1, 1, 1>(cube); break;
+		case 8: turnLayers<2, -1, -1, 1>(cube); break;
+		case 9: turnLayers<0, -1, -1, 1>(cube); break;
+		case 10: turnLayers<1, 1, 1, 1>(cube); break;
+		case 11: turnLayers<1, -1, -1, 1>(cube); break;
+		case 12: turnLayers<1, 1, 1, 3>(cube); break;	// spin left
+		case 13: turnLayers<1, 1, -1, 3>(cube); break;	// spin right
+		case 14: turnLayers<0, 1, -1, 3>(cube); break;	// spin up
+		case 15: turnLayers<0, 1, 1, 3>(cube); break;	// spin down
+		case 16: turnLayers<2, 1, -1, 2>(cube); break;	// f
+		case 17: turnLayers<0, 1, -1, 2>(cube); break;
+		case 18: turnLayers<2, -1, 1, 2>(cube); break;
+		case 19: turnLayers<0, -1, 1, 2>(cube); break;
+		case 20: turnLayers<1, 1, -1, 2>(cube); break;
+		case 21: turnLayers<1, -1, 1, 2>(cube); break;
+		case 22: turnLayers<2, 1, 1, 2>(cube); break;	// -f
+		case 23: turnLayers<0, 1, 1, 2>(cube); break;
+		case 24: turnLayers<2, -1, -1, 2>(cube); break;
+		case 25: turnLayers<0, -1, -1, 2>(cube); break;
+		case 26: turnLayers<1, 1, 1, 2>(cube); break;
+		case 27: turnLayers<1, -1, -1, 2>(cube); break;
+		default: throw "bad move code";
+		}
+	}
 
+	template<typename It>
+	void applyMoves(RubiksCube& cube, It first, It last) {
+		for (; first != last; first++) applyMove(cube, MoveCode(*first));
+	}
 
+	// face move turning the face in direction clockwise
 	Move* moveFor(vec3 direction) {
 		for (int i = 0; i < 6; i++) {
-			FaceMove* move = dynamic_cast<FaceMove*>(allMoves[i]);
-			if (move != nullptr && direction == move->face.direction) {
+			FaceMove* move = static_cast<FaceMove*>(allMoves[i]);	// the first six moves are face moves
+			if (direction == move->face.direction) {
 				return move;
 			}
 		}
 		return nullptr;
 	}
 
-	queue<Move*>  scramble(int amount) {
-		queue<Move*> moves;
+	// random face turns, spins and wide turns
+	vector<MoveCode> scramble(int amount) {
+		vector<MoveCode> moves;
 		for (int i = 0; i < amount; i++) {
-			moves.push(allMoves[nextInt(22)]);
+			moves.push_back(MoveCode(nextInt(22)));
 		}
 		return moves;
 	}
 
 	void scramble(RubiksCube& cube) {
 		auto moves = scramble(20);
-		do {
-			Move& m = *moves.front();
-			moves.pop();
-			m.applyTo(cube);
-		} while (!moves.empty());
+		applyMoves(cube, moves.begin(), moves.end());
 	}
 
 
@@ -264,10 +353,12 @@ namespace rubiks {
 		}
 	}
 
-	queue<Move*> superFlip() {
-		queue<Move*> moves;
-		add({ &U, &R, &R, &F, &B, &R, &B, &B, &R, &U, &U, &L, &B, &B,
-		&R, &_U, &_D, &R, &R, &F, &_R, &L, &B, &B, &U, &U, &F, &F}, moves);
+	vector<MoveCode> superFlip() {
+		vector<MoveCode> moves;
+		for (Move* m : { &U, &R, &R, &F, &B, &R, &B, &B, &R, &U, &U, &L, &B, &B,
+			&R, &_U, &_D, &R, &R, &F, &_R, &L, &B, &B, &U, &U, &F, &F }) {
+			moves.push_back(codeOf(*m));
+		}
 		return moves;
 	}
 
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace rubiks {
+
+	/**
+		Sticker level model of an N x N x N cube, 2 <= N <= 7. Every facelet holds the index of its home
+		face in the F, R, B, L, U, D order of state.h and is stored face by face, row by row, as seen from
+		outside with U up (F, R, B, L) or F down (U) / F up (D).
+
+		Moves turn one layer about an axis: axis 0, 1, 2 is x, y, z (R, U, F), layer 0 is the layer on the
+		positive side and turns are quarter turns clockwise seen from that side. Each layer's move is a
+		list of 4-cycles of facelet indices, so a move costs O(N) for inner slices and O(N^2) only when a
+		whole face turns along with it.
+	*/
+	template<int N>
+	class NxNCube {
+		static_assert(N >= 2 && N <= 7, "NxNCube supports 2x2x2 through 7x7x7");
+
+	public:
+		static const int FACES = 6;
+		static const int FACELETS = FACES * N * N;
+		static const int AXES = 3;
+
+		// a ring of 4 stickers around the layer, plus a quarter of the face when the layer is outer
+		static const int MAX_CYCLES = N + N * N / 4;
+
+		struct LayerMove {
+			uint16_t cycles[MAX_CYCLES][4];
+			int numCycles;
+		};
+
+		NxNCube() {
+			reset();
+		}
+
+		void reset() {
+			for (int i = 0; i < FACELETS; i++) {
+				facelets[i] = uint8_t(i / (N * N));
+			}
+		}
+
+		bool isSolved() const {
+			for (int f = 0; f < FACES; f++) {
+				const uint8_t* face = facelets + f * N * N;
+				for (int i = 1; i < N * N; i++) {
+					if (face[i] != face[0]) return false;
+				}
+			}
+			return true;
+		}
+
+		bool operator==(const NxNCube& other) const {
+			return memcmp(facelets, other.facelets, FACELETS) == 0;
+		}
+
+		uint8_t facelet(int face, int row, int col) const {
+			return facelets[index(face, row, col)];
+		}
+
+		void turn(int axis, int layer, int turns = 1) {
+			const LayerMove& move = moveTable()[axis * N + layer];
+			switch (turns & 3) {
+			case 1:
+				for (int i = 0; i < move.numCycles; i++) {
+					const uint16_t* c = move.cycles[i];
+					uint8_t t = facelets[c[3]];
+					facelets[c[3]] = facelets[c[2]];
+					facelets[c[2]] = facelets[c[1]];
+					facelets[c[1]] = facelets[c[0]];
+					facelets[c[0]] = t;
+				}
+				break;
+			case 2:
+				for (int i = 0; i < move.numCycles; i++) {
+					const uint16_t* c = move.cycles[i];
+					std::swap(facelets[c[0]], facelets[c[2]]);
+					std::swap(facelets[c[1]], facelets[c[3]]);
+				}
+				break;
+			case 3:
+				for (int i = 0; i < move.numCycles; i++) {
+					const uint16_t* c = move.cycles[i];
+					uint8_t t = facelets[c[0]];
+					facelets[c[0]] = facelets[c[1]];
+					facelets[c[1]] = facelets[c[2]];
+					facelets[c[2]] = facelets[c[3]];
+					facelets[c[3]] = t;
+				}
+				break;
+			}
+		}
+
+		// face move in the F, R, B, L, U, D order, depth > 1 turns that many layers together (wide move)
+		void faceTurn(int face, int turns = 1, int depth = 1) {
+			static const int AXIS[FACES] = { 2, 0, 2, 0, 1, 1 };
+			bool positive = face == 0 || face == 1 || face == 4;
+			for (int d = 0; d < depth; d++) {
+				turn(AXIS[face], positive ? d : N - 1 - d, positive ? turns : 4 - (turns & 3));
+			}
+		}
+
+		static int index(int face, int row, int col) {
+			return (face * N + row) * N + col;
+		}
+
+		// one LayerMove per axis and layer, built from the sticker geometry the first time it is needed
+		static const LayerMove* moveTable() {
+			static LayerMove moves[AXES * N];
+			static bool initialized = [&]() {
+				int positions[FACELETS][3];
+				for (int f = 0; f < FACES; f++) {
+					for (int r = 0; r < N; r++) {
+						for (int c = 0; c < N; c++) {
+							positionOf(f, r, c, positions[index(f, r, c)]);
+						}
+					}
+				}
+				auto find = [&](const int p[3]) {
+					for (int i = 0; i < FACELETS; i++) {
+						if (positions[i][0] == p[0] && positions[i][1] == p[1] && positions[i][2] == p[2]) return i;
+					}
+					return -1;
+				};
+
+				for (int axis = 0; axis < AXES; axis++) {
+					for (int layer = 0; layer < N; layer++) {
+						LayerMove& move = moves[axis * N + layer];
+						move.numCycles = 0;
+						bool seen[FACELETS] = {};
+						for (int i = 0; i < FACELETS; i++) {
+							if (seen[i] || layerOf(positions[i], axis) != layer) continue;
+							int p[3] = { positions[i][0], positions[i][1], positions[i][2] };
+							int cycle[4] = { i };
+							for (int k = 1; k < 4; k++) {
+								rotate(p, axis);
+								cycle[k] = find(p);
+							}
+							for (int k = 0; k < 4; k++) seen[cycle[k]] = true;
+							if (cycle[1] == i) continue;	// center of an odd face
+							for (int k = 0; k < 4; k++) move.cycles[move.numCycles][k] = uint16_t(cycle[k]);
+							move.numCycles++;
+						}
+					}
+				}
+				return true;
+			}();
+			return moves;
+		}
+
+		uint8_t facelets[FACELETS];
+
+		// sticker coordinates on a grid scaled by 2, cubie centers are at -(N-1) .. N-1 and faces at +-N
+		static void positionOf(int face, int row, int col, int p[3]) {
+			static const int NORMAL[FACES][3] = { { 0, 0, 1 },{ 1, 0, 0 },{ 0, 0, -1 },{ -1, 0, 0 },{ 0, 1, 0 },{ 0, -1, 0 } };
+			static const int RIGHTWARD[FACES][3] = { { 1, 0, 0 },{ 0, 0, -1 },{ -1, 0, 0 },{ 0, 0, 1 },{ 1, 0, 0 },{ 1, 0, 0 } };
+			static const int DOWNWARD[FACES][3] = { { 0, -1, 0 },{ 0, -1, 0 },{ 0, -1, 0 },{ 0, -1, 0 },{ 0, 0, 1 },{ 0, 0, -1 } };
+			int u = 2 * col - (N - 1);
+			int v = 2 * row - (N - 1);
+			for (int i = 0; i < 3; i++) {
+				p[i] = N * NORMAL[face][i] + u * RIGHTWARD[face][i] + v * DOWNWARD[face][i];
+			}
+		}
+
+	private:
+		static int layerOf(const int p[3], int axis) {
+			if (p[axis] == N) return 0;
+			if (p[axis] == -N) return N - 1;
+			return (N - 1 - p[axis]) / 2;
+		}
+
+		// quarter turn clockwise seen from the positive side of axis
+		static void rotate(int p[3], int axis) {
+			int b = (axis + 1) % 3;
+			int c = (axis + 2) % 3;
+			int t = p[b];
+			p[b] = p[c];
+			p[c] = -t;
+		}
+	};
+}
@@ -19,6 +19,7 @@ const unsigned int Logger::level = LEVEL_DEBUG;
 
 int main()
 {
+	rubiks::setTraceSink(rubiks::streamTraceSink(cout));
 	Scene* scene = new RubiksCubeScene;
 	start(scene);
 
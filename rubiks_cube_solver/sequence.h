@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include "model.h"
+#include "moves.h"
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		Net effect of a sequence of any moves, spins and wide moves included. pieces follows the pieces
+		between positions, labelled by the home faces of their colors, and spin is the part turning the
+		whole cube. A CubeState names pieces after the centers, which spin moves along, so the sequence
+		takes a state s to inverseOf(spin) * s * pieces; centers has the face every center ends up on.
+	*/
+	struct CompiledSequence {
+		CubeState pieces;
+		CubeState spin;
+		uint8_t centers[NUM_FACES];
+
+		static CompiledSequence identity() {
+			CompiledSequence res;
+			res.pieces = res.spin = CubeState::solved();
+			for (int i = 0; i < NUM_FACES; i++) res.centers[i] = i;
+			return res;
+		}
+
+		bool operator==(const CompiledSequence& other) const {
+			return pieces == other.pieces && spin == other.spin;
+		}
+
+		// this sequence followed by other
+		CompiledSequence operator*(const CompiledSequence& other) const {
+			CompiledSequence res;
+			res.pieces = pieces * other.pieces;
+			res.spin = spin * other.spin;
+			for (int i = 0; i < NUM_FACES; i++) res.centers[i] = other.centers[centers[i]];
+			return res;
+		}
+	};
+
+	CompiledSequence inverseOf(const CompiledSequence& sequence) {
+		CompiledSequence res;
+		res.pieces = inverseOf(sequence.pieces);
+		res.spin = inverseOf(sequence.spin);
+		for (int i = 0; i < NUM_FACES; i++) res.centers[sequence.centers[i]] = i;
+		return res;
+	}
+
+	CompiledSequence power(CompiledSequence sequence, int n) {
+		if (n < 0) {
+			sequence = inverseOf(sequence);
+			n = -n;
+		}
+		CompiledSequence res = CompiledSequence::identity();
+		for (; n > 0; n >>= 1) {
+			if (n & 1) res = res * sequence;
+			sequence = sequence * sequence;
+		}
+		return res;
+	}
+
+	// repetitions that bring the cube back to how it started, orientation included
+	long long orderOf(const CompiledSequence& sequence) {
+		long long a = orderOf(sequence.pieces), b = orderOf(sequence.spin);
+		long long x = a, y = b;
+		while (y != 0) {
+			long long t = x % y;
+			x = y;
+			y = t;
+		}
+		return a / x * b;
+	}
+
+	// effect of every move code, read off the geometric model
+	const CompiledSequence* compiledMoves() {
+		static CompiledSequence moves[NUM_MOVES];
+		static bool initialized = [&]() {
+			int homeFaces[NUM_FACES];
+			for (int c = 0; c < NUM_FACES; c++) homeFaces[c] = faceIndex(HOME_DIRECTIONS[c]);
+			for (int i = 0; i < NUM_MOVES; i++) {
+				RubiksCube cube;
+				applyMove(cube, MoveCode(i));
+				CompiledSequence& move = moves[i];
+				move.pieces = stateOf(cube, homeFaces);
+				move.spin = move.pieces * inverseOf(stateOf(cube));
+				for (const Cube& c : cube.cubes) {
+					if (c.type == CENTER) move.centers[homeFaces[colorIndex(c.zc)]] = faceIndex(c.fz);
+				}
+			}
+			return true;
+		}();
+		return moves;
+	}
+
+	template<typename It>
+	CompiledSequence compile(It first, It last) {
+		const CompiledSequence* moves = compiledMoves();
+		CompiledSequence res = CompiledSequence::identity();
+		for (; first != last; first++) res = res * moves[*first];
+		return res;
+	}
+
+	CompiledSequence compile(const MoveSequence& sequence) {
+		return compile(sequence.begin(), sequence.end());
+	}
+
+	CubeState applySequence(const CubeState& state, const CompiledSequence& sequence) {
+		return inverseOf(sequence.spin) * state * sequence.pieces;
+	}
+
+	// applies the whole sequence to rCube at once
+	void applySequence(RubiksCube& rCube, const CompiledSequence& sequence) {
+		Snapshot snapshot = snapshotOf(rCube);
+		snapshot.state = applySequence(snapshot.state, sequence);
+		snapshot.up = sequence.centers[snapshot.up];
+		snapshot.front = sequence.centers[snapshot.front];
+		restore(rCube, snapshot);
+	}
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec3 vNormal;
+in vec4 vColor;
+
+out vec4 fragColor;
+
+void main() {
+	vec3 n = normalize(vNormal);
+	float diffuse = max(dot(n, normalize(vec3(0.4, 0.7, 0.6))), 0.0);
+	fragColor = vec4(vColor.rgb * (0.45 + 0.55 * diffuse), vColor.a);
+}
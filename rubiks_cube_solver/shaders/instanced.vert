@@ -0,0 +1,20 @@
+#version 330 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in mat4 model;
+layout(location = 6) in vec4 color;
+layout(location = 7) in float moving;
+
+uniform mat4 viewProjection;
+uniform mat4 layerRotation;
+
+out vec3 vNormal;
+out vec4 vColor;
+
+void main() {
+	mat4 m = moving > 0.5 ? layerRotation * model : model;
+	vNormal = mat3(m) * normal;
+	vColor = color;
+	gl_Position = viewProjection * m * vec4(position, 1.0);
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "bounds.h"
+
+namespace rubiks {
+
+	// bumped whenever what the segment holds changes meaning without its size changing
+	const uint32_t SHARED_TABLES_VERSION = 1;
+
+	const char* const DEFAULT_SHARED_TABLES = "/rubiks-pattern-tables";
+
+	const char SHARED_TABLES_MAGIC[8] = { 'R', 'U', 'B', 'I', 'K', 'S', 'P', 'T' };
+
+	/**
+		Start of the segment, the tables follow at TABLES_OFFSET. ready is set last, once the tables and
+		their checksum are written, so a process that maps the segment while it is being published sees 0.
+		layout is a hash of the coordinates and tables the block is made of, which catches builds that
+		changed PATTERN_TABLES but not the version.
+	*/
+	struct SharedTablesHeader {
+		static const size_t TABLES_OFFSET = 64;
+
+		char magic[8];
+		uint32_t version;
+		uint32_t layout;
+		uint64_t size;
+		uint64_t checksum;
+		atomic<uint32_t> ready;
+	};
+
+	uint32_t patternTablesLayout() {
+		uint32_t h = 2166136261u;
+		auto mix = [&h](uint32_t value) { h = (h ^ value) * 16777619u; };
+		for (int c = 0; c < NUM_COORDINATES; c++) mix(uint32_t(COORDINATE_SIZES[c]));
+		for (int t = 0; t < NUM_PATTERN_TABLES; t++) mix(uint32_t(PATTERN_TABLES[t].first) << 8 | PATTERN_TABLES[t].second);
+		mix(uint32_t(PatternTables::size()));
+		return h;
+	}
+
+	// a word at a time, about a millisecond for the 3.3 MB
+	uint64_t tablesChecksum(const uint8_t* block, size_t size) {
+		uint64_t h = 0;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, block + i, 8);
+			h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+			h ^= h >> 31;
+		}
+		for (; i < size; i++) h = (h ^ block[i]) * 0x9E3779B97F4A7C15ULL;
+		return h;
+	}
+
+	/**
+		The pattern tables in a named shared memory segment (shm_open on POSIX, a named file mapping on
+		Windows) so that every solver process on a host reads one physical copy and a new process has
+		them as soon as it maps them instead of spending most of a second building its own. Segments are
+		mapped read only, the publisher's too once it is done writing.
+
+		On POSIX a segment outlives its publisher until remove; on Windows it goes away with the last
+		process that has it mapped.
+	*/
+	class SharedPatternTables {
+	public:
+		/**
+			Maps the segment called name; nullptr when there is none, it is still being published, or it
+			holds tables of another version or layout or that fail their checksum.
+		*/
+		static unique_ptr<SharedPatternTables> attach(const string& name) {
+			unique_ptr<SharedPatternTables> shared(new SharedPatternTables());
+#ifdef _WIN32
+			shared->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, windowsName(name).c_str());
+			if (!shared->mapping) return nullptr;
+			shared->base = MapViewOfFile(shared->mapping, FILE_MAP_READ, 0, 0, 0);
+			if (!shared->base) return nullptr;
+			MEMORY_BASIC_INFORMATION info;
+			VirtualQuery(shared->base, &info, sizeof(info));
+			shared->length = info.RegionSize;
+#else
+			int fd = shm_open(name.c_str(), O_RDONLY, 0);
+			if (fd < 0) return nullptr;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || size_t(st.st_size) < SharedTablesHeader::TABLES_OFFSET) {
+				close(fd);
+				return nullptr;
+			}
+			void* base = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (base == MAP_FAILED) return nullptr;
+			shared->base = base;
+			shared->length = size_t(st.st_size);
+#endif
+			if (!shared->valid()) return nullptr;
+			return shared;
+		}
+
+		/**
+			Builds the tables into a new segment called name. nullptr when there already is one, unless
+			replace, which unlinks it first on POSIX; processes that have the old one mapped keep it.
+			Throws when shared memory cannot be had.
+		*/
+		static unique_ptr<SharedPatternTables> publish(const string& name, bool replace = false) {
+			size_t length = SharedTablesHeader::TABLES_OFFSET + PatternTables::size();
+			unique_ptr<SharedPatternTables> shared(new SharedPatternTables());
+#ifdef _WIN32
+			shared->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(length) >> 32), DWORD(length), windowsName(name).c_str());
+			if (!shared->mapping) throw runtime_error("unable to create shared memory " + name);
+			if (GetLastError() == ERROR_ALREADY_EXISTS) return nullptr;
+			shared->base = MapViewOfFile(shared->mapping, FILE_MAP_WRITE, 0, 0, length);
+			if (!shared->base) throw runtime_error("unable to map shared memory " + name);
+#else
+			if (replace) shm_unlink(name.c_str());
+			int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+			if (fd < 0 && errno == EEXIST) return nullptr;
+			if (fd < 0) throw runtime_error("unable to create shared memory " + name);
+			if (ftruncate(fd, off_t(length)) != 0) {
+				close(fd);
+				shm_unlink(name.c_str());
+				throw runtime_error("unable to size shared memory " + name);
+			}
+			void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (base == MAP_FAILED) {
+				shm_unlink(name.c_str());
+				throw runtime_error("unable to map shared memory " + name);
+			}
+			shared->base = base;
+#endif
+			shared->length = length;
+
+			// the segment starts out zeroed, so ready is already 0 for anyone who maps it now
+			uint8_t* bytes = static_cast<uint8_t*>(shared->base);
+			SharedTablesHeader* header = shared->header();
+			uint8_t* tables = bytes + SharedTablesHeader::TABLES_OFFSET;
+			PatternTables::buildInto(tables);
+			memcpy(header->magic, SHARED_TABLES_MAGIC, sizeof(header->magic));
+			header->version = SHARED_TABLES_VERSION;
+			header->layout = patternTablesLayout();
+			header->size = PatternTables::size();
+			header->checksum = tablesChecksum(tables, PatternTables::size());
+			header->ready.store(1, memory_order_release);
+#ifdef _WIN32
+			DWORD old;
+			VirtualProtect(shared->base, length, PAGE_READONLY, &old);
+#else
+			mprotect(shared->base, length, PROT_READ);
+#endif
+			return shared;
+		}
+
+		/**
+			Unlinks the segment called name, false when there was none. Always false on Windows, where a
+			mapping has no name to unlink and goes away when the last process that maps it unmaps it.
+		*/
+		static bool remove(const string& name) {
+#ifdef _WIN32
+			return false;
+#else
+			return shm_unlink(name.c_str()) == 0;
+#endif
+		}
+
+		~SharedPatternTables() {
+#ifdef _WIN32
+			if (base) UnmapViewOfFile(base);
+			if (mapping) CloseHandle(mapping);
+#else
+			if (base) munmap(base, length);
+#endif
+		}
+
+		// PatternTables::size() bytes
+		const uint8_t* tables() const {
+			return static_cast<const uint8_t*>(base) + SharedTablesHeader::TABLES_OFFSET;
+		}
+
+		const SharedTablesHeader& info() const {
+			return *header();
+		}
+
+	private:
+		SharedPatternTables() :base(nullptr), length(0) {}
+
+		SharedPatternTables(const SharedPatternTables&) = delete;
+		SharedPatternTables& operator=(const SharedPatternTables&) = delete;
+
+#ifdef _WIN32
+		// names of file mappings have no leading slash, and Local\ keeps them to the session
+		static string windowsName(const string& name) {
+			size_t start = name.find_first_not_of('/');
+			return "Local\\" + (start == string::npos ? string() : name.substr(start));
+		}
+#endif
+
+		SharedTablesHeader* header() const {
+			return static_cast<SharedTablesHeader*>(base);
+		}
+
+		bool valid() const {
+			const SharedTablesHeader* h = header();
+			return length >= SharedTablesHeader::TABLES_OFFSET + PatternTables::size()
+				&& h->ready.load(memory_order_acquire) == 1
+				&& memcmp(h->magic, SHARED_TABLES_MAGIC, sizeof(h->magic)) == 0
+				&& h->version == SHARED_TABLES_VERSION
+				&& h->layout == patternTablesLayout()
+				&& h->size == PatternTables::size()
+				&& h->checksum == tablesChecksum(tables(), PatternTables::size());
+		}
+
+		void* base;
+		size_t length;
+#ifdef _WIN32
+		HANDLE mapping = nullptr;
+#endif
+	};
+
+	/**
+		Makes PatternTables::instance() read the tables from the segment called name, publishing it first
+		when nobody has. A process that finds another one publishing waits for it, and one that finds a
+		segment that stays unusable for five seconds, left by another version or by a publisher that died,
+		replaces it. False when instance() had already built its own tables or the segment could not be
+		had; the tables are then private to the process, as without shared memory.
+	*/
+	bool useSharedPatternTables(const string& name = DEFAULT_SHARED_TABLES) {
+		static unique_ptr<SharedPatternTables> shared;	// mapped for as long as the process runs
+		if (shared) return PatternTables::attach(shared->tables());
+		auto giveUp = chrono::steady_clock::now() + chrono::seconds(5);
+		for (;;) {
+			bool stale = chrono::steady_clock::now() > giveUp;
+			shared = SharedPatternTables::attach(name);
+			try {
+				if (!shared) shared = SharedPatternTables::publish(name, stale);
+			}
+			catch (const runtime_error&) {	// no shared memory to be had, from the system or for this name
+				return false;
+			}
+			if (shared) return PatternTables::attach(shared->tables());
+			if (stale) return false;
+			this_thread::sleep_for(chrono::milliseconds(50));
+		}
+	}
+}
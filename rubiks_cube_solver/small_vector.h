@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace rubiks {
+
+	/**
+		Vector of trivially copyable items that keeps the first N inline and only goes to the heap past that,
+		so filling one up to N never allocates.
+	*/
+	template<typename T, size_t N>
+	class SmallVector {
+	public:
+		SmallVector() :items(inlineItems), count(0), capacity(N) {}
+
+		SmallVector(const SmallVector& other) :SmallVector() {
+			append(other.begin(), other.end());
+		}
+
+		SmallVector(SmallVector&& other) :SmallVector() {
+			take(other);
+		}
+
+		SmallVector& operator=(const SmallVector& other) {
+			if (this != &other) {
+				clear();
+				append(other.begin(), other.end());
+			}
+			return *this;
+		}
+
+		SmallVector& operator=(SmallVector&& other) {
+			if (this != &other) {
+				if (onHeap()) delete[] items;
+				items = inlineItems;
+				capacity = N;
+				count = 0;
+				take(other);
+			}
+			return *this;
+		}
+
+		~SmallVector() {
+			if (onHeap()) delete[] items;
+		}
+
+		void push_back(const T& item) {
+			if (count == capacity) grow();
+			items[count++] = item;
+		}
+
+		template<typename It>
+		void append(It first, It last) {
+			for (; first != last; first++) push_back(*first);
+		}
+
+		void pop_back() {
+			count--;
+		}
+
+		void clear() {
+			count = 0;
+		}
+
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		bool onHeap() const { return items != inlineItems; }
+
+		T& operator[](size_t i) { return items[i]; }
+		const T& operator[](size_t i) const { return items[i]; }
+		T& back() { return items[count - 1]; }
+		T* begin() { return items; }
+		T* end() { return items + count; }
+		const T* begin() const { return items; }
+		const T* end() const { return items + count; }
+
+	private:
+		void grow() {
+			T* bigger = new T[capacity * 2];
+			std::copy(items, items + count, bigger);
+			if (onHeap()) delete[] items;
+			items = bigger;
+			capacity *= 2;
+		}
+
+		// steals the heap buffer of other or copies its inline items, leaving other empty
+		void take(SmallVector& other) {
+			if (other.onHeap()) {
+				items = other.items;
+				capacity = other.capacity;
+				count = other.count;
+				other.items = other.inlineItems;
+				other.capacity = N;
+			}
+			else {
+				append(other.begin(), other.end());
+			}
+			other.count = 0;
+		}
+
+		T* items;
+		size_t count;
+		size_t capacity;
+		T inlineItems[N];
+	};
+}
@@ -4,37 +4,126 @@
 #include <queue>
 #include <functional>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <glm/glm.hpp>
 #include "model.h"
 #include "moves.h"
 #include "io.h"
 #include "util.h"
+#include "state.h"
+#include "f2l.h"
+#include "lastlayer.h"
+#include "small_vector.h"
+#include "trace.h"
 
 namespace rubiks {
 
+	// typical solutions fit inline, so solving does not allocate for the result
+	using Solution = SmallVector<MoveCode, 256>;
+
+	// lets another thread stop a solve early
+	class CancellationToken {
+	public:
+		void cancel() {
+			cancelled = true;
+		}
+
+		void reset() {
+			cancelled = false;
+		}
+
+		bool isCancelled() const {
+			return cancelled.load(memory_order_relaxed);
+		}
+
+	private:
+		atomic<bool> cancelled{ false };
+	};
+
+	/**
+		Deadline and cancellation token a solve checks in every stage and search loop. Solvers that work in
+		stages throw when they are hit, search solvers give up and return the best they have, which may be
+		no moves at all.
+	*/
+	struct SolveLimits {
+		using Clock = chrono::steady_clock;
+
+		Clock::time_point deadline = Clock::time_point::max();
+		const CancellationToken* token = nullptr;
+
+		static SolveLimits within(Clock::duration budget, const CancellationToken* token = nullptr) {
+			SolveLimits limits;
+			limits.deadline = Clock::now() + budget;
+			limits.token = token;
+			return limits;
+		}
+
+		bool expired() const {
+			if (token && token->isCancelled()) return true;
+			return deadline != Clock::time_point::max() && Clock::now() >= deadline;
+		}
+	};
+
 	class Solver {
 	public:
-		virtual queue<Move*> solve(RubiksCube& cube) = 0;
+		using MoveSink = function<void(MoveCode)>;
+
+		virtual Solution solve(RubiksCube& cube, const SolveLimits& limits = SolveLimits()) = 0;
+
+		// solves the cube handing every move to sink, solvers that work in stages hand them over as each stage completes
+		virtual void stream(RubiksCube& cube, MoveSink sink, const SolveLimits& limits = SolveLimits()) {
+			for (MoveCode m : solve(cube, limits)) {
+				sink(m);
+			}
+		}
 	};
 
 	class SimpleSolver : public Solver {
 	public:
 		SimpleSolver() {}
 
-		virtual queue<Move*> solve(RubiksCube& cube) {
+		virtual Solution solve(RubiksCube& cube, const SolveLimits& limits = SolveLimits()) override {
+			Solution moves;
+			stream(cube, [&](MoveCode m) { moves.push_back(m); }, limits);
+			return moves;
+		}
+
+		// moves of the steps completed before the limits were hit are handed to sink before it throws
+		virtual void stream(RubiksCube& cube, MoveSink sink, const SolveLimits& limits = SolveLimits()) override {
 			auto copy = cube;
-			queue<Move*> moves;
+			Solution moves;
+			this->limits = limits;
+			steps = stack<Step>();
 			steps.push(daisy);
 			while (!steps.empty()) {
 				auto step = steps.top();
 				steps.pop();
-				while (!step(copy, moves));
+				do {
+					checkLimits();
+				} while (!step(copy, moves));
+				for (MoveCode m : moves) {
+					sink(m);
+				}
+				moves.clear();
 			}
-			return moves;
 		}
 
 	private:
-		using Step = function<bool(RubiksCube&, queue<Move*>&)>;
+		// applies m to cube through the move kernels and records it in moves
+		static void turn(RubiksCube& cube, Solution& moves, MoveCode m) {
+			applyMove(cube, m);
+			moves.push_back(m);
+		}
+
+		void checkLimits() const {
+			if (!limits.expired()) return;
+			if (limits.token && limits.token->isCancelled()) throw "solve cancelled";
+			throw "solve deadline passed";
+		}
+
+		SolveLimits limits;
+		using Step = function<bool(RubiksCube&, Solution&)>;
 		stack<Step> steps;
 		const static int BOTTOM = 1;
 		const static int SIDES = 0;
@@ -48,7 +137,8 @@ namespace rubiks {
 			});
 		}
 
-		Step daisy = [&](RubiksCube& cube, queue<Move*>& moves) {
+		Step daisy = [&](RubiksCube& cube, Solution& moves) {
+			RUBIKS_STAGE(STAGE_DAISY);
 
 #ifdef DEBUG
 			auto original = cube;
@@ -64,25 +154,17 @@ namespace rubiks {
 			// also check if white cross formed and exit early
 			if (cube.isSolved()) return true;
 
-			// TODO rotate yellow center face to the top
-			if (!UP_FACE.contains(cube.center(YELLOW))) {
+			// spin the yellow center to the top, around the vertical axis first when it is on the left or right
+			while (!UP_FACE.contains(cube.center(YELLOW))) {
+				checkLimits();
 				auto& center = cube.center(YELLOW);
-				const Face& face = *faceFor(center.directionOf(YELLOW));
-
-				auto rot = [&]() {
-					float d = dot(face.direction, UP_FACE.direction);
-					vec3 a = abs(d) == 1 ? vec3(1, 0, 0) : cross(UP_FACE.direction, face.direction);
-					return Rotation{ a, -degrees(acos(d)) };
-				};
-
-				Move* move = new Spin(rot(), "Spin any");
-				move->applyTo(cube);
-				moves.push(move);
+				const Face* face = faceFor(center.directionOf(YELLOW));
+				turn(cube, moves, face == &LEFT_FACE || face == &RIGHT_FACE ? CODE_SPIN_RIGHT : CODE_SPIN_UP);
 			}
 
 
 			if (whiteCrossFormed(cube)) {
-				steps.push(whiteCorners);
+				steps.push(firstTwoLayers);
 				return true;
 			}
 			if (daisyFormed()) {
@@ -90,7 +172,7 @@ namespace rubiks {
 				return true;
 			}
 
-			cout << "executing daisy" << endl;
+			RUBIKS_TRACE(TRACE_INFO, "executing daisy");
 
 			auto edges = cube.find([](Cube& c) {
 				return (c.yc == WHITE || c.zc == WHITE) && c.type == EDGE && faceFor(c.directionOf(WHITE)) != &UP_FACE;
@@ -120,19 +202,17 @@ namespace rubiks {
 					loc = vec3(1, -1, 1) * edge.pos;
 
 					do {
+						checkLimits();
 						Cube& currentOccupant = cube.find([&](Cube& c) { return c.type == EDGE && c.pos == loc; })[0];
 						if (currentOccupant.colorFor(UP_FACE) == WHITE) {
-							U.applyTo(cube);	// create space by rotating the top face
-							moves.push(&U);
+							turn(cube, moves, CODE_U);	// create space by rotating the top face
 							continue;
 						}
 
 						// rotate edge into place
-						Move& move = *moveFor(altDir());
-						move.applyTo(cube);	 // with every move check if cube is solved
-						move.applyTo(cube);
-						moves.push(&move);
-						moves.push(&move);
+						MoveCode move = MoveCode(faceIndex(altDir()));	// the face moves come first, in the order of faceIndex
+						turn(cube, moves, move);
+						turn(cube, moves, move);
 						break;
 					} while (true);
 					break;
@@ -140,18 +220,14 @@ namespace rubiks {
 					const Face& f = *faceFor(dir());
 					if (f.direction != FRONT_FACE.direction) {	// rotate edge face to front
 						if (dir() == RIGHT_FACE.direction) {
-							SPIN_RIGHT.applyTo(cube);
-							moves.push(&SPIN_RIGHT);
+							turn(cube, moves, CODE_SPIN_RIGHT);
 						}
 						else if (dir() == LEFT_FACE.direction) {	// edge is on left face
-							SPIN_LEFT.applyTo(cube);
-							moves.push(&SPIN_LEFT);
+							turn(cube, moves, CODE_SPIN_LEFT);
 						}
 						else if (BACK_FACE.isIn(dir())) {
-							SPIN_RIGHT.applyTo(cube);
-							SPIN_RIGHT.applyTo(cube);
-							moves.push(&SPIN_RIGHT);
-							moves.push(&SPIN_RIGHT);
+							turn(cube, moves, CODE_SPIN_RIGHT);
+							turn(cube, moves, CODE_SPIN_RIGHT);
 						}
 					}
 					if (abs(altDir()) == UP_FACE.direction) {
@@ -160,29 +236,26 @@ namespace rubiks {
 							return c.get().colorFor(UP_FACE) == WHITE;
 						};
 						while (topFrontEdgeIsWhite()) {
-							U.applyTo(cube);
-							moves.push(&U);
+							checkLimits();
+							turn(cube, moves, CODE_U);
 						}
-						F.applyTo(cube);
-						moves.push(&F);
+						turn(cube, moves, CODE_F);
 					}
 
 					loc = round(static_cast<mat4>(SPIN_UP) * vec4(edge.pos, 1)).xyz;
 					do {
+						checkLimits();
 						Cube& currentOccupant = cube.find([&](Cube& c) { return c.type == EDGE && c.pos == loc; })[0];
 						if (currentOccupant.colorFor(UP_FACE) == WHITE) {
-							U.applyTo(cube);	// create space by rotating the top face
-							moves.push(&U);
+							turn(cube, moves, CODE_U);	// create space by rotating the top face
 							continue;
 						}
 						// rotate edge into place
 						if (altDir() == RIGHT_FACE.direction) {
-							R.applyTo(cube);
-							moves.push(&R);
+							turn(cube, moves, CODE_R);
 						}
 						else {
-							_L.applyTo(cube);
-							moves.push(&_L);
+							turn(cube, moves, CODE_L_PRIME);
 						}
 						break;
 					} while (true);
@@ -202,7 +275,8 @@ namespace rubiks {
 			return true;
 		};;
 
-		Step whiteCross = [&](RubiksCube& cube, queue<Move*>& moves) {
+		Step whiteCross = [&](RubiksCube& cube, Solution& moves) {
+			RUBIKS_STAGE(STAGE_WHITE_CROSS);
 
 #ifdef DEBUG
 			auto original = cube;
@@ -210,11 +284,11 @@ namespace rubiks {
 
 			if (cube.isSolved()) return true;
 			if (whiteCrossFormed(cube)) {
-				steps.push(whiteCorners);
+				steps.push(firstTwoLayers);
 				return true;
 			}
 
-			cout << "executing white cross" << endl;
+			RUBIKS_TRACE(TRACE_INFO, "executing white cross");
 
 			auto edges = cube.edgesOf(WHITE);
 			// TODO prioritise based on eges that are already in position
@@ -226,22 +300,19 @@ namespace rubiks {
 				auto inPosition = [&](const Cube& edge) {};
 
 				while (faceFor(altDir()) != &FRONT_FACE) {
-					SPIN_RIGHT.applyTo(cube);
-					moves.push(&SPIN_RIGHT);
+					checkLimits();
+					turn(cube, moves, CODE_SPIN_RIGHT);
 				}
 
 				// rotate until center matches alt color
 				while (FRONT_FACE.center(cube).zc != altColor()) {
+					checkLimits();
 					auto& center = FRONT_FACE.center(cube);
-					auto& _altColor = altColor();
-					d.applyTo(cube);
-					moves.push(&d);
+					turn(cube, moves, CODE_WIDE_D);
 				}
 
-				F.applyTo(cube);
-				F.applyTo(cube);
-				moves.push(&F);
-				moves.push(&F);
+				turn(cube, moves, CODE_F);
+				turn(cube, moves, CODE_F);
 			}
 
 #ifdef DEBUG
@@ -251,562 +322,69 @@ namespace rubiks {
 			}
 #endif
 
-			steps.push(whiteCorners);
-
-			return true;
-		};
-
-		Step whiteCorners = [&](RubiksCube& cube, queue<Move*>& moves) {
-#ifdef DEBUG
-			auto original = cube;
-#endif
-			
-			bool nonStrict = false;
-			
-
-			auto topCornersFirst = [&](Cube& a, Cube& b) {
-				if (&a == &b || a.pos.y == b.pos.y) return false;
-				if (a.pos.y == 1) return true;
-				else return false;
-			};
-
-			if (cube.isSolved()) return true;
-			if (cube.layerIsSolved(LAYER_ONE)) {
-				steps.push(layer2Edges);
-				return true;
-			}
-
-			cout << "executing white corners" << endl;
-
-			auto corners = cube.cornersOf(WHITE);
-			sort(begin(corners), end(corners), topCornersFirst);
-			
-
-			// TODO order by corners point in the up direction
-
-			for (int i = 0; i < corners.size(); i++) {
-	//			if (i == 2) break;
-				Cube& corner = corners[i];
-
-				auto InRightCorner = [&]() { return corner.pos.x == 1 && corner.pos.z == 1; };
-
-				
-				if (cube.isInPlace(corner)) continue;
-
-				while (!InRightCorner()) {
-					SPIN_RIGHT.applyTo(cube);
-					moves.push(&SPIN_RIGHT);
-				}
-
-				if (DOWN_FACE.contains(corner)) {	// flip corner to up face
-					R_U_RI_UI(cube, moves, 1);
-				}
-
-
-				while (!cube.isInPlace(corner, nonStrict)) {
-					d.applyTo(cube);
-					moves.push(&d);
-				} 
-
-				
-				while (!cube.isInPlace(corner)) {
-					R_U_RI_UI(cube, moves, 1);
-
-				} 
-
-			}
-#ifdef DEBUG
-			if (!cube.layerIsSolved(LAYER_ONE)) {
-				save(original);
-				throw "layer one was not solved";
-			}
-#endif
-
-			steps.push(layer2Edges);
-
-			return true;
-		};
-
-		Step layer2Edges = [&](RubiksCube& cube, queue<Move*>& moves) {
-#ifdef DEBUG
-			auto original = cube;
-#endif
-			
-			if (cube.isSolved()) return true;
-			if (cube.layerIsSolved(LAYER_TWO)) {
-				steps.push(yellowCross);
-				return true;
-			}
-
-			cout << "executing layer 2 edges" << endl;
-
-			auto topEdgessFirst = [&](Cube& a, Cube& b) {
-				if (&a == &b || a.pos.y == b.pos.y) return false;
-				if (a.pos.y == 1) return true;
-				else return false;
-			};
-
-			vector<reference_wrapper<Cube>> edges = cube.find([&](Cube& c) { 
-				return c.type == EDGE && (c.yc != WHITE && c.zc != WHITE) 
-					&& (c.yc != YELLOW && c.zc != YELLOW)
-					&& !cube.isInPlace(c) && (c.pos.y != -1);
-			});
-			sort(begin(edges), end(edges), topEdgessFirst);
-
-			vec3 rightEdge{ 1, 0, 1 };
-			vec3 leftEdge{ -1, 0, 1 };
-
-			for (int i = 0; i < edges.size(); i++) {
-				
-				
-				Cube& edge = edges[i];
-				
-				cout << "edge: " << i << ", pos" << edge.pos << endl;
-				//if (i == 3) return true;
-				while (!(FRONT_FACE.contains(edge))) {
-					SPIN_RIGHT.applyTo(cube);
-					moves.push(&SPIN_RIGHT);
-				}
-
-				if (edge.pos == leftEdge) {
-					SPIN_LEFT.applyTo(cube);
-					moves.push(&SPIN_LEFT);
-				}
-
-				bool nonStrict = false;
-				if (edge.pos == rightEdge) {
-					U.applyTo(cube);
-					R.applyTo(cube);
-					U.applyTo(cube);
-					_R.applyTo(cube);
-					_U.applyTo(cube);
-					
-					SPIN_RIGHT.applyTo(cube);
-
-					_L.applyTo(cube);
-					_U.applyTo(cube);
-					L.applyTo(cube);
-					U.applyTo(cube);
-
-					moves.push(&U);
-					moves.push(&R);
-					moves.push(&U);
-					moves.push(&_R);
-					moves.push(&_U);
-					moves.push(&SPIN_RIGHT);
-					moves.push(&_L);
-					moves.push(&_U);
-					moves.push(&L);
-					moves.push(&U);
-
-				}
-
-				while (edge.colorFor(FRONT_FACE) != FRONT_FACE.center(cube).zc) {
-					d.applyTo(cube);
-					moves.push(&d);
-				}
-
-				if(edge.colorFor(UP_FACE) == LEFT_FACE.center(cube).zc){
-					_U.applyTo(cube);
-					_L.applyTo(cube);
-					_U.applyTo(cube);
-					L.applyTo(cube);
-					U.applyTo(cube);
-
-					SPIN_LEFT.applyTo(cube);
-
-					R.applyTo(cube);
-					U.applyTo(cube);
-					_R.applyTo(cube);
-					_U.applyTo(cube);
-
-					moves.push(&_U);
-					moves.push(&_L);
-					moves.push(&_U);
-					moves.push(&L);
-					moves.push(&U);
-					moves.push(&SPIN_LEFT);
-					moves.push(&R);
-					moves.push(&U);
-					moves.push(&_R);
-					moves.push(&_U);
-				}
-				else if (edge.colorFor(UP_FACE) == RIGHT_FACE.center(cube).zc) {
-					U.applyTo(cube);
-					R.applyTo(cube);
-					U.applyTo(cube);
-					_R.applyTo(cube);
-					_U.applyTo(cube);
-
-					SPIN_RIGHT.applyTo(cube);
-
-					_L.applyTo(cube);
-					_U.applyTo(cube);
-					L.applyTo(cube);
-					U.applyTo(cube);
-
-					moves.push(&U);
-					moves.push(&R);
-					moves.push(&U);
-					moves.push(&_R);
-					moves.push(&_U);
-					moves.push(&SPIN_RIGHT);
-					moves.push(&_L);
-					moves.push(&_U);
-					moves.push(&L);
-					moves.push(&U);
-				}
-			}
-
-
-#ifdef DEBUG
-			if (!cube.layerIsSolved(LAYER_TWO)) {
-				save(original);
-				throw "second layer was not solved";
-			}
-#endif
-			steps.push(yellowCross);
+			steps.push(firstTwoLayers);
 
 			return true;
 		};
 
-		Step yellowCross = [&](RubiksCube& cube, queue<Move*>& moves) {
-
+		Step firstTwoLayers = [&](RubiksCube& cube, Solution& moves) {
+			RUBIKS_STAGE(STAGE_FIRST_TWO_LAYERS);
 #ifdef DEBUG
 			auto original = cube;
-			save(original);
-
 #endif
 
-			auto yellowCrossFormed = [&]() {
-				const Cube& center = cube.center(YELLOW);
-				auto edges = cube.edgesAround(center);
-				return all_of(edges.begin(), edges.end(), [&](Cube& c) { return c.colorFor(*faceFor(center.fz)) == YELLOW; });
-			};
-
 			if (cube.isSolved()) return true;
-			if (yellowCrossFormed()) {
-				steps.push(yellowCorner);
-				return true;
-			}
-
-			cout << "executing yellow cross step" << endl;
 
-			auto linePattern = [&]() {
-				return  (cube.cubeAt(vec3(-1, 1, 0)).colorFor(UP_FACE) == YELLOW && cube.cubeAt(vec3(1, 1, 0)).colorFor(UP_FACE) == YELLOW)
-					|| (cube.cubeAt(vec3(0, 1, 1)).colorFor(UP_FACE) == YELLOW && cube.cubeAt(vec3(0, 1, -1)).colorFor(UP_FACE) == YELLOW);
-			};
+			RUBIKS_TRACE(TRACE_INFO, "executing first two layers");
 
-			auto anglePattern = [&]() {
-				// rotate until right corner is found
-				vec3 loc0{ 1, 1, 0 };
-				vec3 loc1{ 0, 1, 1 };
-				float amount = 0;
-
-				for (int i = 0; i < 4; i++) {
-					if (cube.cubeAt(loc0).colorFor(UP_FACE) == YELLOW && cube.cubeAt(loc1).colorFor(UP_FACE) == YELLOW) return true;
-					amount += 90.f;
-					mat4 m = rotate(mat4(1), radians(amount), { 0, 1, 0 });
-					loc0 = round(m * vec4(loc0, 1.0)).xyz;
-					loc1 = round(m * vec4(loc1, 1.0)).xyz;
-		
+			auto play = [&](const MoveSequence& sequence) {
+				for (uint8_t m : sequence) {
+					applyMove(cube, m);
+					moves.push_back(m);
 				}
-				return false;
 			};
 
-			auto linePatternMoves = [&]() {
-				F.applyTo(cube);
-				R.applyTo(cube);
-				U.applyTo(cube);
-				_R.applyTo(cube);
-				_U.applyTo(cube);
-				_F.applyTo(cube);
-
-				moves.push(&F);
-				moves.push(&R);
-				moves.push(&U);
-				moves.push(&_R);
-				moves.push(&_U);
-				moves.push(&_F);
-			};
-
-			auto anglePatternMoves = [&]() {
-				while (!(cube.cubeAt(vec3(1, 1, 0)).colorFor(UP_FACE) == YELLOW && cube.cubeAt(vec3(0, 1, 1)).colorFor(UP_FACE) == YELLOW)) {
-					SPIN_RIGHT.applyTo(cube);
-					moves.push(&SPIN_RIGHT);
+			// each side of the cube in turn becomes the front right slot, whose corner and edge go in together
+			const uint8_t* next = f2lTable();
+			const int inserted = f2lCase(CubeState::solved());
+			for (int slot = 0; slot < 4; slot++) {
+				if (slot > 0) {
+					turn(cube, moves, CODE_SPIN_RIGHT);
 				}
-				f.applyTo(cube);
-				R.applyTo(cube);
-				U.applyTo(cube);
-				_R.applyTo(cube);
-				_U.applyTo(cube);
-				_f.applyTo(cube);
-
-				moves.push(&f);
-				moves.push(&R);
-				moves.push(&U);
-				moves.push(&_R);
-				moves.push(&_U);
-				moves.push(&_f);
-			};
 
-			Rotation r{ {0, 1, 0}, 0 };
-
-			if (linePattern()) {
-				if (cube.cubeAt(vec3(1, 1, 0)).colorFor(UP_FACE) != YELLOW || cube.cubeAt(vec3(-1, 1, 0)).colorFor(UP_FACE) != YELLOW) {
-					SPIN_RIGHT.applyTo(cube);
-					moves.push(&SPIN_RIGHT);
+				play(f2lFreePair(stateOf(cube)));
+				for (int c = f2lCase(stateOf(cube)); c != inserted; c = f2lCase(stateOf(cube))) {
+					checkLimits();
+					if (next[c] == CASE_SOLVED) throw "no f2l case for pair";
+					play(F2L_GENERATORS[next[c]]);
 				}
-
-				linePatternMoves();
-
-			}
-			else if (anglePattern()) {
-				anglePatternMoves();
-			}
-			else {	// DOT pattern
-				linePatternMoves();
-				anglePatternMoves();
 			}
 
 #ifdef DEBUG
-			if (!yellowCrossFormed()) {
+			if (!cube.layerIsSolved(LAYER_ONE) || !cube.layerIsSolved(LAYER_TWO)) {
 				save(original);
-				throw "yellow cross was not formed";
+				throw "first two layers were not solved";
 			}
 #endif
 
-			steps.push(yellowCorner);
+			steps.push(lastLayer);
 
 			return true;
 		};
 
-		Step yellowCorner = [&](RubiksCube& cube, queue<Move*>& moves) {
+		Step lastLayer = [&](RubiksCube& cube, Solution& moves) {
+			RUBIKS_STAGE(STAGE_LAST_LAYER);
 #ifdef DEBUG
 			auto original = cube;
-			save(original);
-
 #endif
 
-			auto yellowCornersFormed = [&]() {
-				const Cube& center = cube.center(YELLOW);
-				auto corners = cube.cornersAround(center);
-				return all_of(corners.begin(), corners.end(), [&](Cube& c) { 
-					vector<vec3> colors = c.colors();
-					vector<vec3> faces = c.faces();
-					for (int i = 0; i < colors.size(); i++) {
-						if (faceFor(faces[i])->center(cube).zc != colors[i]) return false;
-					}
-
-					return c.colorFor(*faceFor(center.fz)) == YELLOW;
-				});
-			};
-
 			if (cube.isSolved()) return true;
-			if (yellowCornersFormed()) {
-				steps.push(solveLayer3);
-				return true;
-			}
-
-			cout << "executiing yellow corner" << endl;
-
-			auto findOutOfPlace = [&](vector<reference_wrapper<Cube>>& corners) {
-				return filter(corners, [&](Cube& c) { return !cube.isInPlace(c, false); });
-			};
-
-
-			auto inPlace = [&](vector<reference_wrapper<Cube>>& corners, bool strict = false) {
-				int count = count_if(corners.begin(), corners.end(), [&](Cube& c) { return cube.isInPlace(c, strict); });
-				return count;
-			};
-
-			auto isAdjacentSwap = [&](vector<reference_wrapper<Cube>>& corners) {
-				auto res = findOutOfPlace(corners);
-				vector<vec3> faces0 = filter(res[0].get().faces(), [](vec3 v) { return faceFor(v) != &UP_FACE; });
-				vector<vec3> faces1 = filter(res[1].get().faces(), [](vec3 v) { return faceFor(v) != &UP_FACE; });
-				return any_of(faces0.begin(), faces0.end(), [&](vec3 dir0) {
-					return any_of(faces1.begin(), faces1.end(), [&](vec3 dir1) {
-						return dir0 == dir1;
-					});
-				});
-			};
-
-			auto swapAdjacentCorners = [&]() {
-				for (int i = 0; i < 3; i++) {
-					R.applyTo(cube);
-					U.applyTo(cube);
-					_R.applyTo(cube);
-					_U.applyTo(cube);
-
-					moves.push(&R);
-					moves.push(&U);
-					moves.push(&_R);
-					moves.push(&_U);
-				}
-
-				SPIN_RIGHT.applyTo(cube);
-				moves.push(&SPIN_RIGHT);
-
-				for (int i = 0; i < 3; i++) {
-					_L.applyTo(cube);
-					_U.applyTo(cube);
-					L.applyTo(cube);
-					U.applyTo(cube);
-
-					moves.push(&_L);
-					moves.push(&_U);
-					moves.push(&L);
-					moves.push(&U);
-				}
-			};
-
 
-			auto corners = cube.cornersOf(YELLOW);
+			RUBIKS_TRACE(TRACE_INFO, "executing last layer");
 
-
-			while (inPlace(corners) < 2) {
-				U.applyTo(cube);
-				moves.push(&U);
-			}
-
-			if (inPlace(corners) == 2) {
-				if (isAdjacentSwap(corners)) {
-					auto res = findOutOfPlace(corners);
-					Cube& corner0 = res[0];
-					Cube& corner1 = res[1];
-					while (!(RIGHT_FACE.contains(corner0) && RIGHT_FACE.contains(corner1))) {
-						SPIN_LEFT.applyTo(cube);
-						moves.push(&SPIN_LEFT);
-					} 
-
-					swapAdjacentCorners();
-
-					while (inPlace(corners) < 2) {
-						U.applyTo(cube);
-						moves.push(&U);
-					}
-				}
-				else {	// diagonal corners
-					swapAdjacentCorners();
-					
-
-					while (inPlace(corners) < 2) {
-						U.applyTo(cube);
-						moves.push(&U);
-					}
-					
-					
-					auto res = findOutOfPlace(corners);
-					Cube& corner0 = res[0];
-					Cube& corner1 = res[1];
-
-					while (!(RIGHT_FACE.contains(corner0) && RIGHT_FACE.contains(corner1))) {
-						SPIN_LEFT.applyTo(cube);
-						moves.push(&SPIN_LEFT);
-					}
-
-					swapAdjacentCorners();
-
-					while (inPlace(corners) < 4) {
-						U.applyTo(cube);
-						moves.push(&U);
-					}
-					
-				}
-			}
-
-			
-			SPIN_DOWN.applyTo(cube);
-			SPIN_DOWN.applyTo(cube);
-			moves.push(&SPIN_DOWN);
-			moves.push(&SPIN_DOWN);
-
-			vec3 bottomRight = vec3(1, -1, 1);
-
-			auto outOfPlaceCorners = find_if(corners.begin(), corners.end(), [&](Cube& c) { return !cube.isInPlace(c); });
-
-			for (; outOfPlaceCorners != corners.end(); outOfPlaceCorners++) {
-				Cube& corner = *outOfPlaceCorners;
-				cout << "corner: " << corner.pos << endl;
-				while (corner.pos != bottomRight) {
-					D.applyTo(cube);
-					moves.push(&D);
-				}
-
-				while (faceFor(corner.directionOf(YELLOW)) != &DOWN_FACE) {
-					R_U_RI_UI(cube, moves, 1);
-				}
-			}
-
-			SPIN_UP.applyTo(cube);
-			SPIN_UP.applyTo(cube);
-			moves.push(&SPIN_UP);
-			moves.push(&SPIN_UP);
-
-			// Any top corner will do
-			Cube& corner = cube.cubeAt({ 1, 1, 1 });	// front top right corner
-			vec3 color = corner.colorFor(FRONT_FACE);
-			auto face = [&]() { return *faceFor(corner.directionOf(color)); };
-			while (face().center(cube).zc != color) {
-				U.applyTo(cube);
-				moves.push(&U);
-			}
-			
-
-#ifdef DEBUG
-			if (!yellowCornersFormed()) {
-				save(original);
-				throw "yellow cross was not formed";
-			}
-#endif
-			steps.push(solveLayer3);
-			// TODO next step
-			return true;
-		};
-		
-		Step solveLayer3 = [&](RubiksCube& cube, queue<Move*>& moves) {
-#ifdef DEBUG
-			auto original = cube;
-			save(original);
-
-#endif
-			
-			auto mayBeSolveCube = [&]() {
-				R_U_RI_UI(cube, moves, 1);
-				LI_UI_L_U(cube, moves, 1);
-
-				R_U_RI_UI(cube, moves, 5);
-				LI_UI_L_U(cube, moves, 5);
-			};
-
-			auto applyMovesForWhen1FaceSolved = [&]() {
-				auto& face = *findin(sides, [&](const Face* f) { return f->isSolved(cube); });
-				Cube& center = face.center(cube);
-				while (center.fz != FRONT_FACE.direction) {	// todo implemented == for face
-					SPIN_RIGHT.applyTo(cube);
-					moves.push(&SPIN_RIGHT);
-				}
-
-				mayBeSolveCube();
-				if (!cube.isSolved()) {
-					mayBeSolveCube();
-				}
-			};
-
-			auto anyFaceSolved = [&]() {
-				return exists(sides, [&](const Face* f) { return f->isSolved(cube); });
-			};
-
-			cout << "executing layer 3 solution" << endl;
-			
-			while (!cube.isSolved()) {
-				if (anyFaceSolved()) {
-					applyMovesForWhen1FaceSolved();
-				}
-				else {	// No face solved
-					mayBeSolveCube();
-					applyMovesForWhen1FaceSolved();
-				}
+			for (uint8_t m : lastLayerSolution(stateOf(cube))) {
+				applyMove(cube, m);
+				moves.push_back(m);
 			}
 
 #ifdef DEBUG
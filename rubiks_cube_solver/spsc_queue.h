@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace rubiks {
+
+	/**
+		Bounded lock free queue for exactly one producer thread and one consumer thread. head is only
+		written by the consumer and tail only by the producer, each on its own cache line.
+	*/
+	template<typename T, size_t Capacity>
+	class SpscQueue {
+		static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+	public:
+		SpscQueue() :head(0), tail(0) {}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		// producer side, fails when the queue is full
+		bool push(const T& value) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+			items[t & (Capacity - 1)] = value;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side, fails when the queue is empty
+		bool pop(T& value) {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire)) return false;
+			value = items[h & (Capacity - 1)];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		// a snapshot, the other side may change it right after
+		size_t size() const {
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+
+		bool empty() const {
+			return size() == 0;
+		}
+
+	private:
+		alignas(64) std::atomic<size_t> head;
+		alignas(64) std::atomic<size_t> tail;
+		alignas(64) T items[Capacity];
+	};
+}
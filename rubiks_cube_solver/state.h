@@ -0,0 +1,412 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <glm/glm.hpp>
+#include "model.h"
+#include "moves.h"
+
+namespace rubiks {
+
+	const int NUM_CORNERS = 8;
+	const int NUM_EDGES = 12;
+	const int NUM_FACE_MOVES = 12;
+
+	// slot (and piece) numbering of the compact state, U is +y, R is +x and F is +z
+	enum Corner { URF, UFL, ULB, UBR, DFR, DLF, DBL, DRB };
+	enum Edge { UR, UF, UL, UB, DR, DF, DL, DB, FR, FL, BL, BR };
+
+	// facelets of every slot, corners are listed clockwise starting with the U/D facelet
+	const vec3 CORNER_FACELETS[NUM_CORNERS][3] = {
+		{ UP, RIGHT, FRONT },{ UP, FRONT, LEFT },{ UP, LEFT, BACK },{ UP, BACK, RIGHT },
+		{ DOWN, FRONT, RIGHT },{ DOWN, LEFT, FRONT },{ DOWN, BACK, LEFT },{ DOWN, RIGHT, BACK }
+	};
+
+	const vec3 EDGE_FACELETS[NUM_EDGES][2] = {
+		{ UP, RIGHT },{ UP, FRONT },{ UP, LEFT },{ UP, BACK },
+		{ DOWN, RIGHT },{ DOWN, FRONT },{ DOWN, LEFT },{ DOWN, BACK },
+		{ FRONT, RIGHT },{ FRONT, LEFT },{ BACK, LEFT },{ BACK, RIGHT }
+	};
+
+	// home direction of every color in ALL_COLORS, as laid out by RubiksCube::reset
+	const vec3 HOME_DIRECTIONS[NUM_FACES] = { FRONT, RIGHT, LEFT, DOWN, UP, BACK };
+
+	const vec3 FACE_DIRECTIONS[NUM_FACES] = { FRONT, RIGHT, BACK, LEFT, UP, DOWN };
+
+	// face index in the same order as the face moves in allMoves: F, R, B, L, U, D
+	int faceIndex(const vec3 direction) {
+		if (direction.z > 0) return 0;
+		if (direction.x > 0) return 1;
+		if (direction.z < 0) return 2;
+		if (direction.x < 0) return 3;
+		if (direction.y > 0) return 4;
+		return 5;
+	}
+
+	int colorIndex(const vec3 color) {
+		for (int i = 0; i < NUM_FACES; i++) {
+			if (ALL_COLORS[i] == color) return i;
+		}
+		return -1;
+	}
+
+	int inverseOf(int move) {
+		return (move + 6) % NUM_FACE_MOVES;
+	}
+
+	/**
+		Cubie level state of a RubiksCube, cp/ep hold the piece in each slot and co/eo its twist/flip.
+		Pieces are named after the centers they belong to, so a state does not change when the whole cube
+		is spun and a solved cube is always the identity.
+	*/
+	struct CubeState {
+		uint8_t cp[NUM_CORNERS];
+		uint8_t co[NUM_CORNERS];
+		uint8_t ep[NUM_EDGES];
+		uint8_t eo[NUM_EDGES];
+
+		static CubeState solved() {
+			CubeState state;
+			for (int i = 0; i < NUM_CORNERS; i++) {
+				state.cp[i] = i;
+				state.co[i] = 0;
+			}
+			for (int i = 0; i < NUM_EDGES; i++) {
+				state.ep[i] = i;
+				state.eo[i] = 0;
+			}
+			return state;
+		}
+
+		bool isSolved() const {
+			return *this == solved();
+		}
+
+		bool operator==(const CubeState& other) const {
+			return memcmp(this, &other, sizeof(CubeState)) == 0;
+		}
+
+		bool operator!=(const CubeState& other) const {
+			return !(*this == other);
+		}
+
+		// state reached by applying other on top of this state
+		CubeState operator*(const CubeState& other) const {
+			CubeState res;
+			for (int i = 0; i < NUM_CORNERS; i++) {
+				res.cp[i] = cp[other.cp[i]];
+				res.co[i] = (co[other.cp[i]] + other.co[i]) % 3;
+			}
+			for (int i = 0; i < NUM_EDGES; i++) {
+				res.ep[i] = ep[other.ep[i]];
+				res.eo[i] = eo[other.ep[i]] ^ other.eo[i];
+			}
+			return res;
+		}
+	};
+
+	CubeState inverseOf(const CubeState& state) {
+		CubeState res;
+		for (int i = 0; i < NUM_CORNERS; i++) {
+			res.cp[state.cp[i]] = i;
+			res.co[state.cp[i]] = (3 - state.co[i]) % 3;
+		}
+		for (int i = 0; i < NUM_EDGES; i++) {
+			res.ep[state.ep[i]] = i;
+			res.eo[state.ep[i]] = state.eo[i];
+		}
+		return res;
+	}
+
+	// state applied n times, by repeated squaring; negative n applies the inverse
+	CubeState power(CubeState state, int n) {
+		if (n < 0) {
+			state = inverseOf(state);
+			n = -n;
+		}
+		CubeState res = CubeState::solved();
+		for (; n > 0; n >>= 1) {
+			if (n & 1) res = res * state;
+			state = state * state;
+		}
+		return res;
+	}
+
+	/**
+		Number of times state has to be applied to get back to solved: the lcm of its cycles, each counted
+		three (corners) or two (edges) times over when the pieces in it come back twisted or flipped.
+	*/
+	long long orderOf(const CubeState& state) {
+		long long order = 1;
+		auto include = [&](long long length) {
+			long long a = order, b = length;
+			while (b != 0) {
+				long long t = a % b;
+				a = b;
+				b = t;
+			}
+			order = order / a * length;
+		};
+		bool seen[NUM_EDGES] = {};
+		for (int i = 0; i < NUM_CORNERS; i++) {
+			if (seen[i]) continue;
+			int length = 0, twist = 0;
+			for (int j = i; !seen[j]; j = state.cp[j]) {
+				seen[j] = true;
+				length++;
+				twist += state.co[j];
+			}
+			include(twist % 3 ? length * 3 : length);
+		}
+		fill(begin(seen), end(seen), false);
+		for (int i = 0; i < NUM_EDGES; i++) {
+			if (seen[i]) continue;
+			int length = 0, flip = 0;
+			for (int j = i; !seen[j]; j = state.ep[j]) {
+				seen[j] = true;
+				length++;
+				flip += state.eo[j];
+			}
+			include(flip % 2 ? length * 2 : length);
+		}
+		return order;
+	}
+
+	int faceMask(const vec3 pos) {
+		int mask = 0;
+		if (pos.x != 0) mask |= 1 << faceIndex({ pos.x, 0, 0 });
+		if (pos.y != 0) mask |= 1 << faceIndex({ 0, pos.y, 0 });
+		if (pos.z != 0) mask |= 1 << faceIndex({ 0, 0, pos.z });
+		return mask;
+	}
+
+	// slot whose facelets cover exactly the faces in mask, indexed by faceMask
+	const int* slotsByMask() {
+		static int slots[1 << NUM_FACES] = {};
+		static bool initialized = [&]() {
+			for (int i = 0; i < NUM_CORNERS; i++) {
+				slots[faceMask(CORNER_FACELETS[i][0] + CORNER_FACELETS[i][1] + CORNER_FACELETS[i][2])] = i;
+			}
+			for (int i = 0; i < NUM_EDGES; i++) {
+				slots[faceMask(EDGE_FACELETS[i][0] + EDGE_FACELETS[i][1])] = i;
+			}
+			return true;
+		}();
+		return slots;
+	}
+
+	// state with the pieces labelled by faceOfColor, the face index of each color in ALL_COLORS
+	CubeState stateOf(const RubiksCube& rCube, const int* faceOfColor) {
+		const int* slots = slotsByMask();
+		auto label = [&](const Cube& c, const vec3 direction) {
+			return faceOfColor[colorIndex(c.colorFor(*faceFor(direction)))];
+		};
+		auto isUpOrDown = [](int face) { return face >= 4; };
+
+		CubeState state;
+		for (const Cube& c : rCube.cubes) {
+			if (c.type == CORNER) {
+				int slot = slots[faceMask(c.pos)];
+				int mask = 0;
+				for (int j = 0; j < 3; j++) {
+					int face = label(c, CORNER_FACELETS[slot][j]);
+					mask |= 1 << face;
+					if (isUpOrDown(face)) state.co[slot] = j;
+				}
+				state.cp[slot] = slots[mask];
+			}
+			else if (c.type == EDGE) {
+				int slot = slots[faceMask(c.pos)];
+				int first = label(c, EDGE_FACELETS[slot][0]);
+				int second = label(c, EDGE_FACELETS[slot][1]);
+				int piece = slots[(1 << first) | (1 << second)];
+				state.ep[slot] = piece;
+				state.eo[slot] = first == faceIndex(EDGE_FACELETS[piece][0]) ? 0 : 1;
+			}
+		}
+		return state;
+	}
+
+	CubeState stateOf(const RubiksCube& rCube) {
+		int faceOfColor[NUM_FACES];
+		for (const Cube& c : rCube.cubes) {
+			if (c.type == CENTER) faceOfColor[colorIndex(c.zc)] = faceIndex(c.fz);
+		}
+		return stateOf(rCube, faceOfColor);
+	}
+
+	// effect of each face move in allMoves on a solved cube, read of the geometric model
+	const CubeState* faceMoveStates() {
+		static CubeState states[NUM_FACE_MOVES];
+		static bool initialized = [&]() {
+			for (int i = 0; i < NUM_FACE_MOVES; i++) {
+				RubiksCube cube;
+				allMoves[i]->applyTo(cube);
+				states[i] = stateOf(cube);
+			}
+			return true;
+		}();
+		return states;
+	}
+
+	CubeState applyMove(const CubeState& state, int move) {
+		return state * faceMoveStates()[move];
+	}
+
+	using MoveSequence = vector<uint8_t>;	// indices into allMoves
+
+	CubeState applySequence(CubeState state, const MoveSequence& sequence) {
+		for (uint8_t move : sequence) state = applyMove(state, move);
+		return state;
+	}
+
+	MoveSequence inverseOf(const MoveSequence& sequence) {
+		MoveSequence inverse;
+		for (auto it = sequence.rbegin(); it != sequence.rend(); it++) inverse.push_back(uint8_t(inverseOf(*it)));
+		return inverse;
+	}
+
+	/**
+		Appends moves to sequence, merging turns of the same face where the two meet: U U' cancels, U U U
+		becomes U'. Only a move at the very end can merge, so what it cancels may let the next one merge too.
+	*/
+	void appendMerged(MoveSequence& sequence, const MoveSequence& moves) {
+		for (uint8_t move : moves) {
+			int face = move % 6, turns = move < 6 ? 1 : 3;
+			while (!sequence.empty() && sequence.back() % 6 == face) {
+				turns += sequence.back() < 6 ? 1 : 3;
+				sequence.pop_back();
+			}
+			turns %= 4;
+			if (turns == 3) sequence.push_back(uint8_t(face + 6));
+			else sequence.insert(sequence.end(), turns, uint8_t(face));
+		}
+	}
+
+	const uint8_t CASE_SOLVED = 0xFF;
+
+	/**
+		Case table for a stage of a solver. caseOf maps a state to one of size cases and must only depend on
+		pieces the generators move the same way whatever the rest of the cube is. For every case reachable
+		from the solved one, next gets the generator that starts the shortest (in face moves) sequence of
+		generators back to it, found with a Dijkstra search backwards from the solved case; the solved case
+		and unreachable ones get CASE_SOLVED. If algorithms is given, it gets the whole chain of generators
+		of every case joined into one sequence, with appendMerged; empty for the solved and unreachable cases.
+	*/
+	void buildCaseTable(const vector<MoveSequence>& generators, function<int(const CubeState&)> caseOf, uint8_t* next, int size,
+		vector<MoveSequence>* algorithms = nullptr) {
+		vector<int> cost(size, INT_MAX);
+		vector<int> towards(size, -1);	// case the generator in next leads to
+		vector<int> settled;	// cases in the order their cost became final
+		vector<CubeState> representatives(size);
+		vector<MoveSequence> inverses;
+		for (const MoveSequence& g : generators) inverses.push_back(inverseOf(g));
+		fill(next, next + size, CASE_SOLVED);
+
+		priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> open;
+		CubeState solved = CubeState::solved();
+		int start = caseOf(solved);
+		representatives[start] = solved;
+		cost[start] = 0;
+		open.push({ 0, start });
+		while (!open.empty()) {
+			auto top = open.top();
+			open.pop();
+			if (top.first > cost[top.second]) continue;
+			settled.push_back(top.second);
+			for (size_t g = 0; g < generators.size(); g++) {
+				CubeState previous = applySequence(representatives[top.second], inverses[g]);
+				int c = caseOf(previous);
+				int d = top.first + int(generators[g].size());
+				if (d < cost[c]) {
+					cost[c] = d;
+					next[c] = uint8_t(g);
+					towards[c] = top.second;
+					representatives[c] = previous;
+					open.push({ d, c });
+				}
+			}
+		}
+
+		if (!algorithms) return;
+		algorithms->assign(size, MoveSequence());
+		for (int c : settled) {	// the case a generator leads to is always settled before the one it starts from
+			if (c == start) continue;
+			MoveSequence& algorithm = (*algorithms)[c];
+			algorithm = generators[next[c]];
+			appendMerged(algorithm, (*algorithms)[towards[c]]);
+		}
+	}
+
+	/**
+		Everything a RubiksCube holds in 42 bytes: the piece state and the faces the yellow and red centers point to.
+	*/
+	struct Snapshot {
+		CubeState state;
+		uint8_t up;
+		uint8_t front;
+
+		bool operator==(const Snapshot& other) const {
+			return state == other.state && up == other.up && front == other.front;
+		}
+	};
+
+	Snapshot snapshotOf(const RubiksCube& rCube) {
+		Snapshot snapshot;
+		snapshot.state = stateOf(rCube);
+		for (const Cube& c : rCube.cubes) {
+			if (c.type != CENTER) continue;
+			if (c.zc == YELLOW) snapshot.up = faceIndex(c.fz);
+			if (c.zc == RED) snapshot.front = faceIndex(c.fz);
+		}
+		return snapshot;
+	}
+
+	// moves every cube of rCube to where the snapshot has it, colors stay with the same Cube entries
+	void restore(RubiksCube& rCube, const Snapshot& snapshot) {
+		const CubeState& state = snapshot.state;
+		vec3 up = FACE_DIRECTIONS[snapshot.up];
+		vec3 front = FACE_DIRECTIONS[snapshot.front];
+		mat3 orientation(cross(up, front), up, front);	// home direction to current direction
+
+		int cornerSlot[NUM_CORNERS], edgeSlot[NUM_EDGES];
+		for (int i = 0; i < NUM_CORNERS; i++) cornerSlot[state.cp[i]] = i;
+		for (int i = 0; i < NUM_EDGES; i++) edgeSlot[state.ep[i]] = i;
+
+		const int* slots = slotsByMask();
+		auto directionOf = [&](const vec3 color) { return orientation * HOME_DIRECTIONS[colorIndex(color)]; };
+
+		for (Cube& c : rCube.cubes) {
+			if (c.type == CENTER) {
+				c.pos = c.fz = directionOf(c.zc);
+			}
+			else if (c.type == CORNER) {
+				vec3 dirs[3] = { directionOf(c.xc), directionOf(c.yc), directionOf(c.zc) };
+				int piece = slots[faceMask(dirs[0] + dirs[1] + dirs[2])];
+				int slot = cornerSlot[piece];
+				vec3* facing[3] = { &c.fx, &c.fy, &c.fz };
+				for (int i = 0; i < 3; i++) {
+					int k = 0;
+					while (CORNER_FACELETS[piece][k] != dirs[i]) k++;
+					*facing[i] = CORNER_FACELETS[slot][(k + state.co[slot]) % 3];
+				}
+				c.pos = c.fx + c.fy + c.fz;
+			}
+			else {
+				vec3 dirs[2] = { directionOf(c.yc), directionOf(c.zc) };
+				int piece = slots[faceMask(dirs[0] + dirs[1])];
+				int slot = edgeSlot[piece];
+				vec3* facing[2] = { &c.fy, &c.fz };
+				for (int i = 0; i < 2; i++) {
+					int k = EDGE_FACELETS[piece][0] == dirs[i] ? 0 : 1;
+					*facing[i] = EDGE_FACELETS[slot][k ^ state.eo[slot]];
+				}
+				c.pos = c.fy + c.fz;
+			}
+		}
+	}
+}
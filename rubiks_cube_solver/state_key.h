@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include "model.h"
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		A cube packed into 128 bits. lo has the edge slots, a 4 bit piece each from bit 0 and the flips from
+		bit 48; hi has the corner slots, a 3 bit piece each from bit 0 and a 2 bit twist each from bit 24.
+		Keys of whole cubes also have the faces their up and front centers point to at bits 40 and 44 of hi,
+		so equal keys mean equal cubes; keys of CubeStates leave them 0.
+	*/
+	struct StateKey {
+		uint64_t lo;
+		uint64_t hi;
+
+		StateKey() :lo(0), hi(0) {}
+
+		explicit StateKey(const CubeState& state) :lo(0), hi(0) {
+			for (int i = 0; i < NUM_EDGES; i++) {
+				lo |= uint64_t(state.ep[i]) << (4 * i);
+				lo |= uint64_t(state.eo[i]) << (48 + i);
+			}
+			for (int i = 0; i < NUM_CORNERS; i++) {
+				hi |= uint64_t(state.cp[i]) << (3 * i);
+				hi |= uint64_t(state.co[i]) << (24 + 2 * i);
+			}
+		}
+
+		CubeState state() const {
+			CubeState state;
+			for (int i = 0; i < NUM_EDGES; i++) {
+				state.ep[i] = uint8_t(lo >> (4 * i) & 0xF);
+				state.eo[i] = uint8_t(lo >> (48 + i) & 1);
+			}
+			for (int i = 0; i < NUM_CORNERS; i++) {
+				state.cp[i] = uint8_t(hi >> (3 * i) & 7);
+				state.co[i] = uint8_t(hi >> (24 + 2 * i) & 3);
+			}
+			return state;
+		}
+
+		bool operator==(const StateKey& other) const {
+			return lo == other.lo && hi == other.hi;
+		}
+
+		bool operator!=(const StateKey& other) const {
+			return !(*this == other);
+		}
+
+		bool operator<(const StateKey& other) const {
+			return hi != other.hi ? hi < other.hi : lo < other.lo;
+		}
+
+		// both words multiplied in and the high bits folded down, so the low bits and the top 7 bits are both usable
+		uint64_t hash() const {
+			uint64_t h = lo * 0x9E3779B97F4A7C15ULL ^ hi * 0xC2B2AE3D27D4EB4FULL;
+			h ^= h >> 32;
+			h *= 0xD6E8FEB86659FD93ULL;
+			return h ^ h >> 29;
+		}
+	};
+
+	struct StateKeyHash {
+		size_t operator()(const StateKey& key) const {
+			return size_t(key.hash());
+		}
+	};
+
+	StateKey keyOf(const CubeState& state) {
+		return StateKey(state);
+	}
+
+	StateKey keyOf(const Snapshot& snapshot) {
+		StateKey key(snapshot.state);
+		key.hi |= uint64_t(snapshot.up) << 40 | uint64_t(snapshot.front) << 44;
+		return key;
+	}
+
+	// equal for cubes that look the same, however they got there
+	StateKey keyOf(const RubiksCube& rCube) {
+		return keyOf(snapshotOf(rCube));
+	}
+}
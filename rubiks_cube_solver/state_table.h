@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "large_pages.h"
+#include "state_key.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RUBIKS_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace rubiks {
+
+	inline int lowestBit(uint32_t mask) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return int(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	/**
+		Open addressing table of StateKeys laid out like a Swiss table: a control byte per slot holds empty,
+		deleted or 7 bits of the hash of the key in it, and the bytes of a group of 16 slots are compared
+		to what a probe looks for at once, with SSE2 where there is SSE2. The hash picks the group a probe
+		starts at, the next groups are visited in triangular steps, and a key is only read when its 7 bits
+		match, which other keys do 1 time in 128. Keys sit in one array beside the control bytes, 17 bytes
+		a slot and no allocation per entry, and the table grows at 7/8 full, deleted slots included.
+		Probes land anywhere in arrays of hundreds of MB, so those ask for huge pages to spare the TLB.
+	*/
+	class StateTable {
+	public:
+		static const size_t GROUP_SIZE = 16;
+
+		size_t size() const {
+			return count;
+		}
+
+		bool empty() const {
+			return count == 0;
+		}
+
+		size_t capacity() const {
+			return keys.size();
+		}
+
+	protected:
+		static const size_t NPOS = SIZE_MAX;
+		static const int8_t EMPTY = -128;
+		static const int8_t DELETED = -2;
+
+		StateTable() :count(0), deleted(0) {}
+
+		// slot holding key, NPOS when there is none
+		size_t findSlot(const StateKey& key) const {
+			if (keys.empty()) return NPOS;
+			uint64_t hash = key.hash();
+			int8_t tag = tagOf(hash);
+			size_t groupMask = capacity() / GROUP_SIZE - 1;
+			size_t g = size_t(hash) & groupMask;
+			for (size_t step = 1; ; step++) {
+				const int8_t* group = &control[g * GROUP_SIZE];
+				for (uint32_t m = match(group, tag); m; m &= m - 1) {
+					size_t slot = g * GROUP_SIZE + lowestBit(m);
+					if (keys[slot] == key) return slot;
+				}
+				if (match(group, EMPTY)) return NPOS;
+				g = (g + step) & groupMask;
+			}
+		}
+
+		/**
+			Slot holding key, taken for it when the key is new, which second tells. Growing moves keys to
+			other slots; relocate(to, newCapacity) then gets the slot every old slot went to (NPOS for the
+			empty ones) so the caller can move what it keeps beside the keys.
+		*/
+		template<typename Relocate>
+		pair<size_t, bool> insertSlot(const StateKey& key, Relocate relocate) {
+			if ((count + deleted + 1) * 8 > capacity() * 7) {
+				size_t newCapacity = max(size_t(GROUP_SIZE), capacity());
+				if ((count + 1) * 16 > newCapacity * 7) newCapacity *= 2;	// otherwise dropping the deleted slots is enough
+				rehash(newCapacity, relocate);
+			}
+			uint64_t hash = key.hash();
+			int8_t tag = tagOf(hash);
+			size_t groupMask = capacity() / GROUP_SIZE - 1;
+			size_t g = size_t(hash) & groupMask;
+			size_t free = NPOS;
+			for (size_t step = 1; ; step++) {
+				const int8_t* group = &control[g * GROUP_SIZE];
+				for (uint32_t m = match(group, tag); m; m &= m - 1) {
+					size_t slot = g * GROUP_SIZE + lowestBit(m);
+					if (keys[slot] == key) return{ slot, false };
+				}
+				uint32_t empty = match(group, EMPTY);
+				if (free == NPOS) {
+					uint32_t available = empty | match(group, DELETED);
+					if (available) free = g * GROUP_SIZE + lowestBit(available);
+				}
+				if (empty) break;
+				g = (g + step) & groupMask;
+			}
+			if (control[free] == DELETED) deleted--;
+			control[free] = tag;
+			keys[free] = key;
+			count++;
+			return{ free, true };
+		}
+
+		bool eraseSlot(const StateKey& key) {
+			size_t slot = findSlot(key);
+			if (slot == NPOS) return false;
+			control[slot] = DELETED;
+			deleted++;
+			count--;
+			return true;
+		}
+
+		// makes room for n keys without growing
+		template<typename Relocate>
+		void reserveSlots(size_t n, Relocate relocate) {
+			size_t newCapacity = GROUP_SIZE;
+			while (newCapacity * 7 < n * 8) newCapacity *= 2;
+			if (newCapacity > capacity()) rehash(newCapacity, relocate);
+		}
+
+		void clearSlots() {
+			fill(control.begin(), control.end(), int8_t(EMPTY));
+			count = deleted = 0;
+		}
+
+		bool isFull(size_t slot) const {
+			return control[slot] >= 0;
+		}
+
+		vector<int8_t> control;
+		vector<StateKey> keys;
+
+	private:
+		static int8_t tagOf(uint64_t hash) {
+			return int8_t(hash >> 57);
+		}
+
+		// bit i is set when byte i of the group is value
+		static uint32_t match(const int8_t* group, int8_t value) {
+#ifdef RUBIKS_SSE2
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+			return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+			uint32_t mask = 0;
+			for (size_t i = 0; i < GROUP_SIZE; i++) mask |= uint32_t(group[i] == value) << i;
+			return mask;
+#endif
+		}
+
+		template<typename Relocate>
+		void rehash(size_t newCapacity, Relocate relocate) {
+			vector<int8_t> oldControl(std::move(control));
+			vector<StateKey> oldKeys(std::move(keys));
+			control.reserve(newCapacity);
+			keys.reserve(newCapacity);
+			adviseHugePages(control.data(), newCapacity);	// before the pages are touched
+			adviseHugePages(keys.data(), newCapacity * sizeof(StateKey));
+			control.assign(newCapacity, int8_t(EMPTY));
+			keys.assign(newCapacity, StateKey());
+			vector<size_t> to(oldKeys.size(), size_t(NPOS));
+			size_t groupMask = newCapacity / GROUP_SIZE - 1;
+			for (size_t i = 0; i < oldKeys.size(); i++) {
+				if (oldControl[i] < 0) continue;
+				uint64_t hash = oldKeys[i].hash();
+				size_t g = size_t(hash) & groupMask;
+				for (size_t step = 1; ; step++) {
+					uint32_t empty = match(&control[g * GROUP_SIZE], EMPTY);
+					if (empty) {
+						to[i] = g * GROUP_SIZE + lowestBit(empty);
+						break;
+					}
+					g = (g + step) & groupMask;
+				}
+				control[to[i]] = tagOf(hash);
+				keys[to[i]] = oldKeys[i];
+			}
+			deleted = 0;
+			relocate(to, newCapacity);
+		}
+
+		size_t count;
+		size_t deleted;
+	};
+
+	class StateSet : public StateTable {
+	public:
+		// false when key was already in the set
+		bool insert(const StateKey& key) {
+			return insertSlot(key, [](const vector<size_t>&, size_t) {}).second;
+		}
+
+		bool contains(const StateKey& key) const {
+			return findSlot(key) != NPOS;
+		}
+
+		bool erase(const StateKey& key) {
+			return eraseSlot(key);
+		}
+
+		void reserve(size_t n) {
+			reserveSlots(n, [](const vector<size_t>&, size_t) {});
+		}
+
+		void clear() {
+			clearSlots();
+		}
+
+		template<typename F>
+		void forEach(F f) const {
+			for (size_t slot = 0; slot < capacity(); slot++) {
+				if (isFull(slot)) f(keys[slot]);
+			}
+		}
+
+		size_t memoryUsage() const {
+			return capacity() * (sizeof(StateKey) + 1);
+		}
+	};
+
+	// values are kept in their own array, at the slot of their key
+	template<typename Value>
+	class StateMap : public StateTable {
+	public:
+		// value of key, set to value first when key is new, which second tells
+		pair<Value*, bool> insert(const StateKey& key, const Value& value) {
+			pair<size_t, bool> res = insertSlot(key, [this](const vector<size_t>& to, size_t newCapacity) { relocate(to, newCapacity); });
+			if (res.second) values[res.first] = value;
+			return{ &values[res.first], res.second };
+		}
+
+		Value& operator[](const StateKey& key) {
+			return *insert(key, Value()).first;
+		}
+
+		// nullptr when key is not in the map
+		Value* find(const StateKey& key) {
+			size_t slot = findSlot(key);
+			return slot == NPOS ? nullptr : &values[slot];
+		}
+
+		const Value* find(const StateKey& key) const {
+			size_t slot = findSlot(key);
+			return slot == NPOS ? nullptr : &values[slot];
+		}
+
+		bool erase(const StateKey& key) {
+			return eraseSlot(key);
+		}
+
+		void reserve(size_t n) {
+			reserveSlots(n, [this](const vector<size_t>& to, size_t newCapacity) { relocate(to, newCapacity); });
+		}
+
+		void clear() {
+			clearSlots();
+		}
+
+		template<typename F>
+		void forEach(F f) const {
+			for (size_t slot = 0; slot < capacity(); slot++) {
+				if (isFull(slot)) f(keys[slot], values[slot]);
+			}
+		}
+
+		size_t memoryUsage() const {
+			return capacity() * (sizeof(StateKey) + sizeof(Value) + 1);
+		}
+
+	private:
+		void relocate(const vector<size_t>& to, size_t newCapacity) {
+			vector<Value> moved;
+			moved.reserve(newCapacity);
+			adviseHugePages(moved.data(), newCapacity * sizeof(Value));
+			moved.resize(newCapacity);
+			for (size_t i = 0; i < to.size(); i++) {
+				if (to[i] != NPOS) moved[to[i]] = std::move(values[i]);
+			}
+			values.swap(moved);
+		}
+
+		vector<Value> values;
+	};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "model.h"
+#include "moves.h"
+#include "state.h"
+
+namespace rubiks {
+
+	/**
+		History of the moves applied to a cube with a Snapshot every interval moves, so jumping to any
+		point in the history restores the nearest earlier snapshot and replays at most interval - 1 moves.
+		Recording a move after seeking back drops the moves that came after that point.
+	*/
+	class Timeline {
+	public:
+		Timeline(int interval = 16) :interval(interval), current(0) {}
+
+		void reset(const RubiksCube& start) {
+			log.clear();
+			snapshots.clear();
+			snapshots.push_back(snapshotOf(start));
+			current = 0;
+		}
+
+		// move has just been applied, cube is the result
+		void record(MoveCode move, const RubiksCube& cube) {
+			if (current < log.size()) {
+				log.resize(current);
+				snapshots.resize(current / interval + 1);
+			}
+			log.push_back(move);
+			current++;
+			if (current % interval == 0) {
+				snapshots.push_back(snapshotOf(cube));
+			}
+		}
+
+		// puts cube in the state it had after the first index moves
+		void seek(RubiksCube& cube, size_t index) {
+			index = std::min(index, log.size());
+			size_t base = index / interval;
+			restore(cube, snapshots[base]);
+			for (size_t i = base * interval; i < index; i++) {
+				applyMove(cube, log[i]);
+			}
+			current = index;
+		}
+
+		void back(RubiksCube& cube) {
+			if (current > 0) seek(cube, current - 1);
+		}
+
+		void forward(RubiksCube& cube) {
+			seek(cube, current + 1);
+		}
+
+		size_t position() const {
+			return current;
+		}
+
+		size_t size() const {
+			return log.size();
+		}
+
+	private:
+		int interval;
+		size_t current;
+		vector<MoveCode> log;
+		vector<Snapshot> snapshots;
+	};
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include "spsc_queue.h"
+
+using namespace std;
+
+namespace rubiks {
+
+	enum TraceLevel { TRACE_ERROR, TRACE_WARN, TRACE_INFO, TRACE_DEBUG };
+
+	const char* const TRACE_LEVEL_NAMES[] = { "error", "warn", "info", "debug" };
+
+	// records above this level are compiled out
+#ifndef RUBIKS_TRACE_LEVEL
+#define RUBIKS_TRACE_LEVEL rubiks::TRACE_INFO
+#endif
+
+	struct TraceRecord {
+		int64_t time;	// steady clock ticks
+		uint32_t thread;
+		TraceLevel level;
+		char text[112];
+	};
+
+	using TraceSink = function<void(const TraceRecord&)>;
+
+	/**
+		Each thread writes its records to its own ring, so tracing takes no lock and never waits on
+		output; a background thread drains the rings into the sink. Records are dropped, and counted,
+		when a ring is full or no sink is installed, in which case they are not even formatted. The
+		background thread sleeps while the rings are empty and the first record written wakes it.
+	*/
+	class Tracer {
+	public:
+		static const size_t RING_SIZE = 256;
+
+		static Tracer& instance() {
+			static Tracer tracer;
+			return tracer;
+		}
+
+		~Tracer() {
+			setSink(nullptr);
+		}
+
+		// installs sink, or with nullptr flushes what is left and stops tracing
+		void setSink(TraceSink newSink) {
+			lock_guard<mutex> guard(sinkLock);
+			if (flusher.joinable()) {
+				{
+					lock_guard<mutex> wakeGuard(wakeLock);
+					running = false;
+				}
+				wakeup.notify_one();
+				flusher.join();
+			}
+			flush(sink);
+			sink = newSink;
+			enabled = bool(sink);
+			if (enabled) {
+				running = true;
+				flusher = thread([this]() {
+					while (running) {
+						if (flush(sink) > 0) continue;
+						unique_lock<mutex> wakeGuard(wakeLock);
+						sleeping = true;
+						atomic_thread_fence(memory_order_seq_cst);	// pairs with the one in write
+						if (flush(sink) > 0) {	// written before sleeping was seen
+							sleeping = false;
+							continue;
+						}
+						wakeup.wait(wakeGuard, [this]() { return !sleeping || !running; });
+					}
+				});
+			}
+		}
+
+		bool isEnabled() const {
+			return enabled.load(memory_order_relaxed);
+		}
+
+		void write(TraceLevel level, const char* format, va_list args) {
+			Ring& ring = threadRing();
+			TraceRecord record;
+			record.time = chrono::steady_clock::now().time_since_epoch().count();
+			record.thread = ring.id;
+			record.level = level;
+			vsnprintf(record.text, sizeof(record.text), format, args);
+			if (!ring.records.push(record)) {
+				dropped++;
+				return;
+			}
+			atomic_thread_fence(memory_order_seq_cst);	// the flusher either sees the record or is seen sleeping
+			if (sleeping.load(memory_order_relaxed)) {
+				lock_guard<mutex> wakeGuard(wakeLock);
+				sleeping = false;
+				wakeup.notify_one();
+			}
+		}
+
+		// records lost to full rings
+		uint64_t droppedRecords() const {
+			return dropped;
+		}
+
+		// waits until everything traced so far reached the sink
+		void flush() {
+			lock_guard<mutex> guard(sinkLock);
+			flush(sink);
+		}
+
+	private:
+		struct Ring {
+			uint32_t id;
+			SpscQueue<TraceRecord, RING_SIZE> records;
+
+			// plain new only aligns to 16 bytes before C++17, which would undo the cache line padding of the queue
+			static void* operator new(size_t size) {
+				void* p = nullptr;
+#ifdef _WIN32
+				p = _aligned_malloc(size, alignof(Ring));
+#else
+				if (posix_memalign(&p, alignof(Ring), size) != 0) p = nullptr;
+#endif
+				if (!p) throw bad_alloc();
+				return p;
+			}
+
+			static void operator delete(void* p) {
+#ifdef _WIN32
+				_aligned_free(p);
+#else
+				free(p);
+#endif
+			}
+		};
+
+		Tracer() :enabled(false), running(false), sleeping(false), dropped(0) {}
+
+		Ring& threadRing() {
+			thread_local Ring* ring = [this]() {
+				lock_guard<mutex> guard(ringsLock);
+				Ring* ring = new Ring;
+				ring->id = uint32_t(rings.size());
+				rings.push_back(ring);
+				return ring;
+			}();
+			return *ring;
+		}
+
+		// the only consumer of the rings, called by the flusher or with sinkLock held; returns the records written
+		size_t flush(const TraceSink& to) {
+			lock_guard<mutex> guard(consumerLock);
+			vector<Ring*> all;
+			{
+				lock_guard<mutex> ringsGuard(ringsLock);
+				all = rings;
+			}
+			size_t count = 0;
+			TraceRecord record;
+			for (Ring* ring : all) {
+				while (ring->records.pop(record)) {
+					if (to) to(record);
+					count++;
+				}
+			}
+			return count;
+		}
+
+		atomic<bool> enabled;
+		atomic<bool> running;
+		atomic<bool> sleeping;	// the flusher waits on wakeup for the next record
+		atomic<uint64_t> dropped;
+		TraceSink sink;
+		thread flusher;
+		mutex sinkLock;
+		mutex consumerLock;
+		mutex ringsLock;
+		mutex wakeLock;
+		condition_variable wakeup;
+		vector<Ring*> rings;	// rings outlive their threads so late records still reach the sink
+	};
+
+	void setTraceSink(TraceSink sink) {
+		Tracer::instance().setSink(sink);
+	}
+
+	void flushTrace() {
+		Tracer::instance().flush();
+	}
+
+	void trace(TraceLevel level, const char* format, ...) {
+		Tracer& tracer = Tracer::instance();
+		if (!tracer.isEnabled()) return;
+		va_list args;
+		va_start(args, format);
+		tracer.write(level, format, args);
+		va_end(args);
+	}
+
+	// sink printing records one per line to out, e.g. "[info 2] executing daisy"
+	TraceSink streamTraceSink(ostream& out) {
+		return [&out](const TraceRecord& record) {
+			out << '[' << TRACE_LEVEL_NAMES[record.level] << ' ' << record.thread << "] " << record.text << '\n';
+		};
+	}
+}
+
+#define RUBIKS_TRACE(level, ...) do { if ((level) <= RUBIKS_TRACE_LEVEL) rubiks::trace((level), __VA_ARGS__); } while (0)
@@ -7,19 +7,84 @@
 #include <iterator>
 #include <future>
 #include <chrono>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "CppUnitTest.h"
 #include "../rubiks_cube_solver/model.h"
 #include "../rubiks_cube_solver/moves.h"
 #include "../rubiks_cube_solver/solver.h"
 #include "../rubiks_cube_solver/util.h"
 #include "../rubiks_cube_solver/io.h"
+#include "../rubiks_cube_solver/state.h"
+#include "../rubiks_cube_solver/bidirectional.h"
+#include "../rubiks_cube_solver/spsc_queue.h"
+#include "../rubiks_cube_solver/timeline.h"
+#include "../rubiks_cube_solver/nxn.h"
+#include "../rubiks_cube_solver/batch.h"
+#include "../rubiks_cube_solver/f2l.h"
+#include "../rubiks_cube_solver/lastlayer.h"
+#include "../rubiks_cube_solver/small_vector.h"
+#include "../rubiks_cube_solver/sequence.h"
+#include "../rubiks_cube_solver/facelets.h"
+#include "../rubiks_cube_solver/trace.h"
+#include "../rubiks_cube_solver/bounds.h"
+#include "../rubiks_cube_solver/enumerate.h"
+#include "../rubiks_cube_solver/state_table.h"
+#include "../rubiks_cube_solver/external_bfs.h"
+#include "../rubiks_cube_solver/shared_tables.h"
 
 using namespace std;
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace rubiks;
 
 namespace rubiks_cube_solver_tests
-{		
+{
+	// a new directory under the temporary directory, removed with the files in it when it goes out of scope
+	class ScratchDirectory {
+	public:
+		ScratchDirectory(const string& name) {
+#ifdef _WIN32
+			char temp[MAX_PATH + 1];
+			DWORD length = GetTempPathA(sizeof(temp), temp);
+			path = string(temp, length) + name + "-" + to_string(_getpid()) + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count());
+			bool made = _mkdir(path.c_str()) == 0;
+#else
+			const char* temp = getenv("TMPDIR");
+			path = string(temp && *temp ? temp : "/tmp") + "/" + name + "-" + to_string(getpid()) + "-" + to_string(chrono::steady_clock::now().time_since_epoch().count());
+			bool made = mkdir(path.c_str(), 0700) == 0;
+#endif
+			if (!made) throw runtime_error("unable to make " + path);
+		}
+
+		~ScratchDirectory() {
+#ifdef _WIN32
+			WIN32_FIND_DATAA entry;
+			HANDLE found = FindFirstFileA((path + "\\*").c_str(), &entry);
+			if (found != INVALID_HANDLE_VALUE) {
+				do {
+					remove((path + "\\" + entry.cFileName).c_str());
+				} while (FindNextFileA(found, &entry));
+				FindClose(found);
+			}
+			_rmdir(path.c_str());
+#else
+			if (DIR* dir = opendir(path.c_str())) {
+				while (dirent* entry = readdir(dir)) remove((path + "/" + entry->d_name).c_str());
+				closedir(dir);
+			}
+			rmdir(path.c_str());
+#endif
+		}
+
+		string path;
+	};
+
 	TEST_CLASS(ModelUnitTest)
 	{
 	public:
@@ -121,22 +186,22 @@ namespace rubiks_cube_solver_tests
 			RubiksCube cube;
 			RubiksCube copy;
 			SimpleSolver solver;
+			chrono::seconds timeout{ 10 };
 			auto run = [&]() {
 				try {
-					return solver.solve(cube);
+					return solver.solve(cube, SolveLimits::within(timeout));	// gives the thread back if the wait times out
 				}
 				catch (const char* msg) {
 					Logger::WriteMessage(msg);
-					return queue<Move*>{};
+					return Solution{};
 				}
 			};
 			bool failed = false;
-			chrono::seconds timeout{ 10 };
 			int iterations = 1000;
 			for (int i = 0; i < iterations; i++) {
 				scramble(cube);
 				copy = cube;
-				future<queue<Move*>> f = async(launch::async, run);
+				future<Solution> f = async(launch::async, run);
 				future_status status; 
 				
 				status = f.wait_for(timeout);
@@ -231,4 +296,620 @@ namespace rubiks_cube_solver_tests
 		//	Assert::IsTrue(isAdjacentSwap(corners), L"pattern should not be adjacent swap");
 		//}
 	};
+
+	TEST_CLASS(StateUnitTest)
+	{
+	public:
+
+		TEST_METHOD(StateOfSolvedCubeIsSolvedInAnyOrientation) {
+			RubiksCube cube;
+			Assert::IsTrue(stateOf(cube).isSolved(), L"state of a solved cube should be solved");
+
+			SPIN_RIGHT.applyTo(cube);
+			SPIN_UP.applyTo(cube);
+			Assert::IsTrue(stateOf(cube).isSolved(), L"spinning the cube should not change its state");
+		}
+
+		TEST_METHOD(FaceMovesOnStateMatchFaceMovesOnCube) {
+			RubiksCube cube;
+			CubeState state = CubeState::solved();
+			for (int i = 0; i < 200; i++) {
+				int move = nextInt(NUM_FACE_MOVES);
+				allMoves[move]->applyTo(cube);
+				state = applyMove(state, move);
+				Assert::IsTrue(state == stateOf(cube), L"state should follow the moves applied to the cube");
+			}
+		}
+
+		TEST_METHOD(RestoringASnapshotReproducesTheCube) {
+			RubiksCube cube;
+			for (int i = 0; i < 50; i++) allMoves[nextInt(22)]->applyTo(cube);
+			Snapshot snapshot = snapshotOf(cube);
+
+			RubiksCube restored;
+			restore(restored, snapshot);
+			Assert::IsTrue(snapshotOf(restored) == snapshot, L"restored cube should have the snapshot state");
+			for (int i = 0; i < 50; i++) {
+				Move* m = allMoves[nextInt(22)];
+				m->applyTo(cube);
+				m->applyTo(restored);
+			}
+			Assert::IsTrue(snapshotOf(restored) == snapshotOf(cube), L"restored cube should behave like the original");
+		}
+
+		TEST_METHOD(TimelineSeekMatchesReplayingFromTheStart) {
+			RubiksCube cube;
+			Timeline timeline(8);
+			timeline.reset(cube);
+			vector<MoveCode> history;
+			for (int i = 0; i < 100; i++) {
+				MoveCode m = MoveCode(nextInt(NUM_MOVES));
+				allMoves[m]->applyTo(cube);
+				timeline.record(m, cube);
+				history.push_back(m);
+			}
+
+			for (int i = 0; i < 20; i++) {
+				size_t index = nextInt(101);
+				RubiksCube replayed;
+				for (size_t j = 0; j < index; j++) allMoves[history[j]]->applyTo(replayed);
+				timeline.seek(cube, index);
+				Assert::IsTrue(snapshotOf(cube) == snapshotOf(replayed), L"seek should land on the same state as a replay");
+			}
+
+			timeline.seek(cube, 10);
+			timeline.record(codeOf(R), cube);
+			Assert::AreEqual(int(timeline.size()), 11, L"recording after a seek should drop later moves");
+		}
+
+		TEST_METHOD(EveryMoveCodeIsUndoneByItsInverse) {
+			for (int i = 0; i < NUM_MOVES; i++) {
+				Assert::AreEqual(i, int(codeOf(*allMoves[i])), L"code of a move should be its index");
+				Assert::AreEqual(i, int(MOVE_INFO[MOVE_INFO[i].inverse].inverse), L"inverse of the inverse should be the move");
+
+				RubiksCube cube;
+				for (int j = 0; j < 20; j++) allMoves[nextInt(NUM_MOVES)]->applyTo(cube);
+				Snapshot before = snapshotOf(cube);
+				allMoves[i]->applyTo(cube);
+				allMoves[MOVE_INFO[i].inverse]->applyTo(cube);
+				Assert::IsTrue(snapshotOf(cube) == before, L"move followed by its inverse should leave the cube as it was");
+			}
+			Assert::AreEqual(int(CODE_L_PRIME), int(codeOf(_L)), L"named codes should follow allMoves");
+			Assert::AreEqual(int(CODE_SPIN_UP), int(codeOf(SPIN_UP)), L"named codes should follow allMoves");
+			Assert::AreEqual(int(CODE_WIDE_D), int(codeOf(d)), L"named codes should follow allMoves");
+			Assert::AreEqual(int(CODE_WIDE_D_PRIME), int(codeOf(_d)), L"named codes should follow allMoves");
+			for (const vec3 direction : { FRONT, RIGHT, BACK, LEFT, UP, DOWN }) {
+				Assert::AreEqual(int(codeOf(*moveFor(direction))), faceIndex(direction), L"face moves should be in the order of faceIndex");
+			}
+		}
+
+		TEST_METHOD(MoveKernelsMatchTheMoveObjects) {
+			for (int i = 0; i < NUM_MOVES; i++) {
+				RubiksCube cube;
+				for (int j = 0; j < 20; j++) allMoves[nextInt(NUM_MOVES)]->applyTo(cube);
+				RubiksCube copy = cube;
+				allMoves[i]->applyTo(cube);
+				applyMove(copy, MoveCode(i));
+				for (int c = 0; c < NUM_CUBES; c++) {
+					const Cube& a = cube.cubes[c];
+					const Cube& b = copy.cubes[c];
+					Assert::IsTrue(a.pos == b.pos && a.fx == b.fx && a.fy == b.fy && a.fz == b.fz, L"kernel should move every cube like the move object");
+				}
+			}
+		}
+
+		TEST_METHOD(SmallVectorGoesToTheHeapOnlyPastItsInlineSize) {
+			SmallVector<MoveCode, 4> moves;
+			for (int i = 0; i < 4; i++) moves.push_back(MoveCode(i));
+			Assert::IsFalse(moves.onHeap(), L"items up to the inline size should stay inline");
+			for (int i = 4; i < 10; i++) moves.push_back(MoveCode(i));
+			Assert::IsTrue(moves.onHeap(), L"items past the inline size should go to the heap");
+
+			SmallVector<MoveCode, 4> copy = moves;
+			SmallVector<MoveCode, 4> moved = std::move(moves);
+			Assert::IsTrue(moves.empty(), L"moved from vector should be empty");
+			Assert::AreEqual(10, int(copy.size()));
+			Assert::AreEqual(10, int(moved.size()));
+			for (int i = 0; i < 10; i++) {
+				Assert::AreEqual(i, int(copy[i]));
+				Assert::AreEqual(i, int(moved[i]));
+			}
+		}
+
+		TEST_METHOD(CompiledSequenceMatchesPlayingItMoveByMove) {
+			for (int i = 0; i < 50; i++) {
+				RubiksCube cube;
+				for (int j = 0; j < 20; j++) applyMove(cube, MoveCode(nextInt(NUM_MOVES)));
+				MoveSequence sequence;
+				for (int j = 0; j < 30; j++) sequence.push_back(uint8_t(nextInt(NUM_MOVES)));
+
+				CompiledSequence compiled = compile(sequence);
+				CubeState before = stateOf(cube);
+				RubiksCube copy = cube;
+				applyMoves(cube, sequence.begin(), sequence.end());
+				applySequence(copy, compiled);
+				Assert::IsTrue(applySequence(before, compiled) == stateOf(cube), L"compiled sequence should give the same state");
+				Assert::IsTrue(snapshotOf(copy) == snapshotOf(cube), L"compiled sequence should leave the cube the same way");
+				Assert::IsTrue(compiled * inverseOf(compiled) == CompiledSequence::identity(), L"sequence and its inverse should cancel");
+				Assert::IsTrue(power(compiled, 3) == compiled * compiled * compiled, L"power should repeat the sequence");
+			}
+		}
+
+		TEST_METHOD(OrderOfWellKnownSequences) {
+			Assert::AreEqual(6LL, orderOf(compile(MoveSequence{ 1, 4, 7, 10 })), L"R U R' U' has order 6");
+			Assert::AreEqual(105LL, orderOf(compile(MoveSequence{ 1, 4 })), L"R U has order 105");
+			Assert::AreEqual(4LL, orderOf(compile(MoveSequence{ 13 })), L"a spin has order 4");
+			Assert::AreEqual(4LL, orderOf(compile(MoveSequence{ 17 })), L"a wide move has order 4");
+			CubeState sexy = compile(MoveSequence{ 1, 4, 7, 10 }).pieces;
+			Assert::IsTrue(power(sexy, 6).isSolved() && !power(sexy, 3).isSolved());
+		}
+
+		TEST_METHOD(FaceletStringsReadTheStandardLayout) {
+			const string solved = "UUUUUUUUURRRRRRRRRFFFFFFFFFDDDDDDDDDLLLLLLLLLBBBBBBBBB";
+			Assert::IsTrue(parseFacelets(solved).isSolved(), L"solved string should be a solved state");
+			Assert::IsTrue(parseFacelets("UUFUUFUUFRRRRRRRRRFFDFFDFFDDDBDDBDDBLLLLLLLLLUBBUBBUBB") == applyMove(CubeState::solved(), 1), L"string after R should read as R");
+
+			for (int i = 0; i < 50; i++) {
+				RubiksCube cube;
+				for (int j = 0; j < 30; j++) applyMove(cube, MoveCode(nextInt(NUM_FACE_MOVES)));
+				CubeState state = stateOf(cube);
+				Assert::IsTrue(parseFacelets(faceletsOf(state)) == state, L"string of a state should read back as the same state");
+
+				RubiksCube loaded;
+				loadFacelets(loaded, faceletsOf(state));
+				Assert::IsTrue(stateOf(loaded) == state, L"loaded cube should have the state of the string");
+			}
+		}
+
+		TEST_METHOD(FaceletStringsOfImpossibleCubesAreRejected) {
+			const string solved = "UUUUUUUUURRRRRRRRRFFFFFFFFFDDDDDDDDDLLLLLLLLLBBBBBBBBB";
+			auto rejects = [](const string& facelets) {
+				try {
+					parseFacelets(facelets);
+					return false;
+				}
+				catch (const char*) {
+					return true;
+				}
+			};
+
+			string twisted = solved;	// URF corner turned in place
+			twisted[faceletAt({ 1, 1, 1 }, UP)] = 'R';
+			twisted[faceletAt({ 1, 1, 1 }, RIGHT)] = 'F';
+			twisted[faceletAt({ 1, 1, 1 }, FRONT)] = 'U';
+			string flipped = solved;	// UF edge flipped
+			swap(flipped[faceletAt({ 0, 1, 1 }, UP)], flipped[faceletAt({ 0, 1, 1 }, FRONT)]);
+			CubeState swapped = CubeState::solved();
+			swap(swapped.ep[UR], swapped.ep[UF]);
+
+			Assert::IsTrue(rejects(twisted), L"twisted corner should be rejected");
+			Assert::IsTrue(rejects(flipped), L"flipped edge should be rejected");
+			Assert::IsTrue(rejects(faceletsOf(swapped)), L"two swapped edges should be rejected");
+			Assert::IsTrue(rejects(solved.substr(1)), L"short string should be rejected");
+			Assert::IsTrue(rejects(string(54, 'U')), L"string with one color should be rejected");
+			Assert::IsTrue(rejects("UUUUUUUUURRRRRRRRRFFFFFFFFFDDDDDDDDDLLLLLLLLLBBBBBBBBX"), L"unknown letter should be rejected");
+		}
+
+		TEST_METHOD(F2lTableInsertsThePairFromAnyCase) {
+			const uint8_t* next = f2lTable();
+			const int inserted = f2lCase(CubeState::solved());
+			for (int i = 0; i < 200; i++) {
+				// scramble the pairs and the U layer but keep the cross
+				CubeState state = CubeState::solved();
+				for (int j = 0; j < 20; j++) {
+					int slot = nextInt(4);
+					state = applySequence(state, F2L_EXTRACT[slot]);
+					state = applyMove(state, nextInt(2) ? 4 : 10);
+				}
+
+				state = applySequence(state, f2lFreePair(state));
+				Assert::AreEqual(0, f2lStrays(state), L"pair should be out of the other slots");
+				for (int moves = 0; f2lCase(state) != inserted; moves++) {
+					Assert::AreNotEqual(int(CASE_SOLVED), int(next[f2lCase(state)]), L"every case should have an entry");
+					Assert::IsTrue(moves < 10, L"table should not loop");
+					state = applySequence(state, F2L_GENERATORS[next[f2lCase(state)]]);
+				}
+				for (int e = DR; e <= DB; e++) {
+					Assert::IsTrue(state.ep[e] == e && state.eo[e] == 0, L"cross should be kept");
+				}
+			}
+		}
+
+		TEST_METHOD(LastLayerTablesCoverEveryCase) {
+			auto count = [](const uint8_t* next, int size) { return int(count_if(next, next + size, [](uint8_t g) { return g != CASE_SOLVED; })); };
+			Assert::AreEqual(27 * 8 - 1, count(ollTable(), OLL_CASES), L"every orientation case should have an algorithm");
+			Assert::AreEqual(24 * 24 / 2 - 1, count(pllTable(), PLL_CASES), L"every permutation case should have an algorithm");
+
+			for (int i = 0; i < 200; i++) {
+				CubeState state = CubeState::solved();
+				for (int j = 0; j < 10; j++) {
+					state = applySequence(state, nextInt(2) ? OLL_GENERATORS[nextInt(OLL_GENERATORS.size())] : PLL_GENERATORS[nextInt(PLL_GENERATORS.size())]);
+				}
+				CubeState oriented = applySequence(state, ollAlgorithms()[ollCase(state)]);
+				Assert::AreEqual(ollCase(CubeState::solved()), ollCase(oriented), L"one algorithm should orient the last layer");
+				Assert::IsTrue(applySequence(oriented, pllAlgorithms()[pllCase(oriented)]).isSolved(), L"one algorithm should permute it");
+				Assert::IsTrue(applySequence(state, lastLayerSolution(state)).isSolved(), L"last layer should be solved");
+			}
+
+			auto longest = [](const vector<MoveSequence>& algorithms) {
+				size_t length = 0;
+				for (const MoveSequence& a : algorithms) length = max(length, a.size());
+				return int(length);
+			};
+			Assert::IsTrue(longest(ollAlgorithms()) <= 24, L"no orientation algorithm should be longer than 24 moves");
+			Assert::IsTrue(longest(pllAlgorithms()) <= 34, L"no permutation algorithm should be longer than 34 moves");
+		}
+
+		TEST_METHOD(SolversStopWhenTheirLimitsAreHit) {
+			RubiksCube cube;
+			scramble(cube);
+			CancellationToken token;
+			token.cancel();
+
+			SimpleSolver simple;
+			bool threw = false;
+			try {
+				simple.solve(cube, SolveLimits::within(chrono::seconds(10), &token));
+			}
+			catch (const char*) {
+				threw = true;
+			}
+			Assert::IsTrue(threw, L"cancelled solve should throw");
+			RubiksCube solved = cube;
+			for (MoveCode m : simple.solve(cube)) applyMove(solved, m);
+			Assert::IsTrue(solved.isSolved(), L"solver should start over after a cancelled solve");
+
+			RubiksCube far;
+			for (int i = 0; i < 20; i++) applyMove(far, MoveCode(nextInt(NUM_FACE_MOVES)));
+			BidirectionalSolver bidirectional(20);
+			auto start = chrono::steady_clock::now();
+			Solution moves = bidirectional.solve(far, SolveLimits::within(chrono::milliseconds(50)));
+			auto elapsed = chrono::steady_clock::now() - start;
+			Assert::IsTrue(elapsed < chrono::seconds(2), L"search should give up soon after the deadline");
+			RubiksCube copy = far;
+			for (MoveCode m : moves) applyMove(copy, m);
+			Assert::IsTrue(moves.empty() || copy.isSolved(), L"search should return a solution or nothing");
+		}
+
+		TEST_METHOD(BidirectionalSolverFindsOptimalSolutionOfShortScrambles) {
+			BidirectionalSolver solver;
+			for (int i = 0; i < 20; i++) {
+				RubiksCube cube;
+				SPIN_LEFT.applyTo(cube);
+				int length = 1 + nextInt(6);
+				for (int j = 0; j < length; j++) allMoves[nextInt(NUM_FACE_MOVES)]->applyTo(cube);
+
+				RubiksCube copy = cube;
+				Solution moves = solver.solve(cube);
+				Assert::IsTrue(moves.size() <= length, L"solution should not be longer than the scramble");
+				for (MoveCode m : moves) allMoves[m]->applyTo(copy);
+				Assert::IsTrue(copy.isSolved(), L"solution should solve the cube");
+			}
+		}
+
+		TEST_METHOD(LowerBoundNeverExceedsTheOptimalSolution) {
+			Assert::AreEqual(0, lowerBound(CubeState::solved()));
+			for (int m = 0; m < NUM_FACE_MOVES; m++) {
+				Assert::AreEqual(1, lowerBound(applyMove(CubeState::solved(), m)), L"one move away");
+			}
+
+			BidirectionalSolver solver;
+			vector<CubeState> states;
+			for (int i = 0; i < 40; i++) {
+				CubeState state = CubeState::solved();
+				int length = 1 + nextInt(8);
+				for (int j = 0; j < length; j++) state = applyMove(state, nextInt(NUM_FACE_MOVES));
+				int bound = lowerBound(state);
+				Assert::IsTrue(bound <= int(solver.search(state).size()), L"bound should not exceed the optimal solution");
+				states.push_back(state);
+			}
+			vector<uint8_t> bounds = lowerBounds(states);
+			for (size_t i = 0; i < states.size(); i++) {
+				Assert::AreEqual(lowerBound(states[i]), int(bounds[i]), L"batch should match one at a time");
+			}
+
+			RubiksCube cube;
+			SPIN_UP.applyTo(cube);
+			R.applyTo(cube);
+			U.applyTo(cube);
+			Assert::AreEqual(2, lowerBound(cube), L"spins should not count");
+		}
+
+		TEST_METHOD(SharedPatternTablesMatchTheOnesBuiltInProcess) {
+			const string name = "/rubiks-pattern-tables-test";
+			SharedPatternTables::remove(name);
+			Assert::IsTrue(SharedPatternTables::attach(name) == nullptr, L"nothing to attach to before publishing");
+			auto published = SharedPatternTables::publish(name);
+			Assert::IsTrue(published != nullptr, L"publishing should create the segment");
+			Assert::IsTrue(SharedPatternTables::publish(name) == nullptr, L"a second publisher should find it taken");
+
+			auto attached = SharedPatternTables::attach(name);
+			Assert::IsTrue(attached != nullptr, L"a published segment should attach");
+			Assert::AreEqual(SHARED_TABLES_VERSION, attached->info().version);
+			const uint8_t* own = PatternTables::instance().data();
+			Assert::IsTrue(equal(own, own + PatternTables::size(), attached->tables()), L"shared tables should be the ones built here");
+			attached.reset();
+			published.reset();
+			SharedPatternTables::remove(name);
+		}
+
+		TEST_METHOD(PlacedPatternTablesGiveTheSameBounds) {
+			vector<CubeState> states;
+			CubeState state = CubeState::solved();
+			for (int i = 0; i < 200; i++) {
+				state = applyMove(state, nextInt(NUM_FACE_MOVES));
+				states.push_back(state);
+			}
+			vector<uint8_t> before = lowerBounds(states);
+
+			PlacedMemory memory(PatternTables::size(), HUGE_PAGES_2MB, INTERLEAVED);
+			Assert::IsTrue(memory.size() >= PatternTables::size(), L"placed memory should hold the tables");
+			Assert::AreEqual(size_t(0), size_t(memory.data()) % memory.pageSize(), L"placed memory should start on a page");
+			PatternTables::place(HUGE_PAGES_2MB, NUMA_REPLICATE);
+			bool copied = PatternTables::local().data() != PatternTables::instance().data();
+			vector<uint8_t> placed = lowerBounds(states);
+			PatternTables::place(SMALL_PAGES, NUMA_DEFAULT);	// back to the tables every other test uses
+			Assert::IsTrue(copied, L"lookups should go to the copy");
+			Assert::IsTrue(before == placed, L"copies should give the same bounds");
+			Assert::IsTrue(PatternTables::local().data() == PatternTables::instance().data(), L"dropping the copies should restore instance()");
+		}
+
+		TEST_METHOD(SpilledEnumerationMatchesTheOneInMemory) {
+			CubeState state = applySequence(CubeState::solved(), MoveSequence{ 3, 7, 4, 0, 10, 5, 2 });
+			Assert::IsTrue(stateOf(rankOf(state, 0)) == state, L"ranks should give back the state");
+
+			DepthEnumerator memory(CubeState::solved());
+			ScratchDirectory scratch("rubiks-spill-test");
+			ExternalEnumerator disk(CubeState::solved(), scratch.path, 0);	// the smallest buffer, so every layer spills many runs
+			for (int depth = 1; depth <= 4; depth++) {
+				Assert::AreEqual(int(memory.expand()), int(disk.expand()), L"same count at every depth");
+			}
+			Assert::IsTrue(disk.runs() > 1, L"the last layer should have been merged from several runs");
+			vector<StateKey> inMemory, onDisk;
+			memory.forEach([&](const CubeState& s) { inMemory.push_back(StateKey(s)); });
+			disk.forEach([&](const CubeState& s) { onDisk.push_back(StateKey(s)); });
+			sort(onDisk.begin(), onDisk.end());
+			Assert::IsTrue(inMemory == onDisk, L"same states at the last depth");
+		}
+
+		TEST_METHOD(RunsBeyondTheFanInAreMergedInSeveralPasses) {
+			DepthEnumerator memory(CubeState::solved());
+			ScratchDirectory scratch("rubiks-fan-in-test");
+			ExternalEnumerator disk(CubeState::solved(), scratch.path, 0, 2);	// about ten runs at depth 4, two read at once
+			for (int depth = 1; depth <= 4; depth++) {
+				Assert::AreEqual(int(memory.expand()), int(disk.expand()), L"same count at every depth");
+			}
+			Assert::IsTrue(disk.runs() > 4, L"there should be more runs than two passes of two can take");
+			Assert::IsTrue(disk.passes() > 2, L"the runs should have been merged in several passes");
+			vector<StateKey> inMemory, onDisk;
+			memory.forEach([&](const CubeState& s) { inMemory.push_back(StateKey(s)); });
+			disk.forEach([&](const CubeState& s) { onDisk.push_back(StateKey(s)); });
+			sort(onDisk.begin(), onDisk.end());
+			Assert::IsTrue(inMemory == onDisk, L"same states at the last depth");
+		}
+
+		TEST_METHOD(StateKeysPackEveryPieceAndTellCubesApart) {
+			CubeState state = applySequence(CubeState::solved(), MoveSequence{ 0, 1, 4, 9, 2, 11, 5 });
+			Assert::IsTrue(StateKey(state).state() == state, L"unpacking should give back the state");
+			Assert::IsTrue(StateKey(state) != StateKey(CubeState::solved()));
+
+			RubiksCube a, b;
+			R.applyTo(a);
+			R.applyTo(b);
+			Assert::IsTrue(keyOf(a) == keyOf(b), L"same moves, same key");
+			SPIN_LEFT.applyTo(b);
+			Assert::IsTrue(keyOf(a) != keyOf(b), L"a spun cube looks different");
+			SPIN_RIGHT.applyTo(b);
+			Assert::IsTrue(keyOf(a) == keyOf(b), L"until it is spun back");
+		}
+
+		TEST_METHOD(StateTableKeepsEveryKeyThroughGrowthAndErasure) {
+			vector<StateKey> keys;
+			DepthEnumerator enumerator(CubeState::solved());
+			for (int depth = 1; depth <= 4; depth++) {
+				enumerator.expand();
+				for (const DepthEnumerator::Position& p : enumerator.layer()) keys.push_back(p.key);
+			}
+
+			StateSet set;
+			StateMap<int> map;
+			for (size_t i = 0; i < keys.size(); i++) {
+				Assert::IsTrue(set.insert(keys[i]), L"keys are distinct");
+				map.insert(keys[i], int(i));
+			}
+			Assert::IsFalse(set.insert(keys[0]), L"second insert should find the key");
+			Assert::AreEqual(int(keys.size()), int(set.size()));
+			for (size_t i = 0; i < keys.size(); i += 2) {
+				set.erase(keys[i]);
+				map.erase(keys[i]);
+			}
+			for (size_t i = 0; i < keys.size(); i++) {
+				Assert::AreEqual(i % 2 == 1, set.contains(keys[i]));
+				const int* value = map.find(keys[i]);
+				Assert::IsTrue(i % 2 == 1 ? value != nullptr && *value == int(i) : value == nullptr, L"values should stay with their keys");
+			}
+			for (size_t i = 0; i < keys.size(); i += 2) map[keys[i]] = -1;
+			Assert::AreEqual(int(keys.size()), int(map.size()), L"erased slots should be reused");
+			Assert::IsFalse(set.contains(StateKey(CubeState::solved())));
+		}
+
+		TEST_METHOD(EnumeratorCountsTheStatesAtEveryDepth) {
+			const size_t COUNTS[] = { 1, 12, 114, 1068, 10011 };	// known quarter turn counts
+			CubeState scrambled = applySequence(CubeState::solved(), MoveSequence{ 1, 4, 8, 2, 11 });
+			for (const CubeState& start : { CubeState::solved(), scrambled }) {
+				DepthEnumerator enumerator(start);
+				for (int depth = 1; depth < 5; depth++) {
+					Assert::AreEqual(int(COUNTS[depth]), int(enumerator.expand()), L"every start has the same counts");
+				}
+			}
+
+			DepthEnumerator enumerator(CubeState::solved());
+			for (int depth = 1; depth <= 4; depth++) enumerator.expand();
+			BidirectionalSolver solver;
+			for (size_t i = 0; i < enumerator.layer().size(); i += 97) {
+				Assert::AreEqual(4, int(solver.search(enumerator.layer()[i].key.state()).size()), L"states at depth 4 should need 4 moves");
+			}
+		}
+	};
+
+	TEST_CLASS(BatchUnitTest)
+	{
+	public:
+
+		TEST_METHOD(BatchMovesMatchMovesOnEachState) {
+			unique_ptr<CubeBatch<128>> batch(new CubeBatch<128>());
+			vector<CubeState> states;
+			for (size_t k = 0; k < batch->size(); k++) {
+				CubeState state = CubeState::solved();
+				for (int i = 0; i < 20; i++) state = applyMove(state, nextInt(NUM_FACE_MOVES));
+				batch->set(k, state);
+				states.push_back(state);
+			}
+
+			for (int i = 0; i < 100; i++) {
+				int move = nextInt(NUM_FACE_MOVES);
+				batch->applyMove(move);
+				for (CubeState& state : states) state = applyMove(state, move);
+			}
+			for (size_t k = 0; k < batch->size(); k++) {
+				Assert::IsTrue(batch->get(k) == states[k], L"batch should hold the same state as the scalar moves");
+			}
+		}
+
+		TEST_METHOD(SolvedMaskFlagsSolvedCubes) {
+			unique_ptr<CubeBatch<128>> batch(new CubeBatch<128>());
+			Assert::IsTrue(batch->solvedMask(0) == ~0ULL && batch->solvedMask(1) == ~0ULL, L"new batch should be solved");
+
+			batch->applyMove(1);
+			batch->set(70, CubeState::solved());
+			batch->applyMove(inverseOf(1));
+			Assert::IsTrue(batch->solvedMask(0) == ~0ULL, L"undone move should leave the cubes solved");
+			Assert::IsTrue(batch->solvedMask(1) == ~(1ULL << 6), L"only the reset cube should be scrambled");
+		}
+	};
+
+	TEST_CLASS(NxNUnitTest)
+	{
+	public:
+
+		TEST_METHOD(FaceTurnsOn3x3MatchFaceMovesOnCube) {
+			RubiksCube cube;
+			NxNCube<3> nxn;
+			for (int i = 0; i < 100; i++) {
+				int move = nextInt(NUM_FACE_MOVES);
+				allMoves[move]->applyTo(cube);
+				nxn.faceTurn(move % 6, move < 6 ? 1 : 3);
+			}
+
+			for (int i = 0; i < NxNCube<3>::FACELETS; i++) {
+				int p[3];
+				NxNCube<3>::positionOf(i / 9, i / 3 % 3, i % 3, p);
+				vec3 normal(p[0] / 3, p[1] / 3, p[2] / 3);
+				vec3 pos(p[0] / 2, p[1] / 2, p[2] / 2);
+				Cube& c = *find_if(begin(cube.cubes), end(cube.cubes), [&](Cube& c) { return c.pos == pos; });
+				int home = faceIndex(HOME_DIRECTIONS[colorIndex(c.colorFor(*faceFor(normal)))]);
+				Assert::AreEqual(home, int(nxn.facelets[i]), L"facelet should have the color of the geometric model");
+			}
+		}
+
+		template<int N>
+		void checkMovesAreUndone() {
+			NxNCube<N> cube;
+			vector<int> axes, layers, turns;
+			for (int i = 0; i < 200; i++) {
+				axes.push_back(nextInt(3));
+				layers.push_back(nextInt(N));
+				turns.push_back(1 + nextInt(3));
+				cube.turn(axes.back(), layers.back(), turns.back());
+			}
+			Assert::IsFalse(cube.isSolved(), L"cube should be scrambled");
+			for (int i = 199; i >= 0; i--) {
+				cube.turn(axes[i], layers[i], 4 - turns[i]);
+			}
+			Assert::IsTrue(cube.isSolved(), L"inverse sequence should solve the cube");
+		}
+
+		TEST_METHOD(SliceMovesOnAnySizeAreUndoneByTheirInverses) {
+			checkMovesAreUndone<2>();
+			checkMovesAreUndone<3>();
+			checkMovesAreUndone<4>();
+			checkMovesAreUndone<5>();
+			checkMovesAreUndone<6>();
+			checkMovesAreUndone<7>();
+		}
+
+		TEST_METHOD(WholeCubeRotationKeepsTheCubeSolved) {
+			NxNCube<5> cube;
+			for (int layer = 0; layer < 5; layer++) cube.turn(0, layer);
+			Assert::IsTrue(cube.isSolved(), L"turning every layer is a rotation");
+			cube.faceTurn(1, 1, 2);
+			Assert::IsFalse(cube.isSolved(), L"wide move should scramble the cube");
+			for (int i = 0; i < 3; i++) cube.faceTurn(1, 1, 2);
+			Assert::IsTrue(cube.isSolved(), L"wide move has order four");
+		}
+	};
+
+	TEST_CLASS(ConcurrencyUnitTest)
+	{
+	public:
+
+		TEST_METHOD(SpscQueueHandsOverItemsInOrder) {
+			SpscQueue<int, 64> items;
+			const int count = 100000;
+			thread producer([&]() {
+				for (int i = 0; i < count; i++) {
+					while (!items.push(i)) this_thread::yield();
+				}
+			});
+
+			bool inOrder = true;
+			for (int expected = 0; expected < count;) {
+				int item;
+				if (items.pop(item)) {
+					inOrder = inOrder && item == expected;
+					expected++;
+				}
+			}
+			producer.join();
+			Assert::IsTrue(inOrder, L"items should arrive in the order they were pushed");
+			Assert::IsTrue(items.empty(), L"queue should be empty after every item was consumed");
+		}
+
+		TEST_METHOD(TraceRecordsOfEveryThreadReachTheSinkInOrder) {
+			mutex lock;
+			vector<vector<int>> received(64);
+			atomic<bool> lateArrived{ false };
+			setTraceSink([&](const TraceRecord& record) {
+				lock_guard<mutex> guard(lock);
+				int n = atoi(record.text + 7);	// after "record "
+				if (n == 1000) lateArrived = true;
+				else if (record.thread < received.size()) received[record.thread].push_back(n);
+			});
+
+			vector<thread> threads;
+			for (int t = 0; t < 4; t++) {
+				threads.emplace_back([]() {
+					for (int i = 0; i < 100; i++) {
+						RUBIKS_TRACE(TRACE_INFO, "record %d", i);
+						this_thread::yield();
+					}
+				});
+			}
+			for (thread& t : threads) t.join();
+
+			this_thread::sleep_for(chrono::milliseconds(20));	// long enough for the flusher to go to sleep
+			RUBIKS_TRACE(TRACE_INFO, "record %d", 1000);
+			for (int i = 0; i < 200 && !lateArrived; i++) this_thread::sleep_for(chrono::milliseconds(10));
+			Assert::IsTrue(lateArrived, L"a record should wake the flusher");
+			flushTrace();
+			setTraceSink(nullptr);
+
+			size_t total = 0;
+			for (const vector<int>& records : received) {
+				total += records.size();
+				Assert::IsTrue(is_sorted(records.begin(), records.end()), L"records of a thread should arrive in order");
+			}
+			Assert::AreEqual(400 - int(Tracer::instance().droppedRecords()), int(total), L"every record kept should reach the sink");
+		}
+	};
 }
\ No newline at end of file
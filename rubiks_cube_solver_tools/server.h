@@ -0,0 +1,505 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX	// the min and max macros of windows.h break std::min and std::max
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <csignal>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define RUBIKS_UNIX_SOCKETS	// Windows has AF_UNIX only from SDK 10.0.17063 on, newer than the tools build with
+#endif
+#include "stress.h"
+#include "../rubiks_cube_solver/bounds.h"
+#include "../rubiks_cube_solver/facelets.h"
+#include "../rubiks_cube_solver/shared_tables.h"
+#include "../rubiks_cube_solver/state_key.h"
+
+namespace rubiks {
+
+#ifdef _WIN32
+	using Socket = SOCKET;
+	const Socket NO_SOCKET = INVALID_SOCKET;
+
+	void closeSocket(Socket socket) {
+		closesocket(socket);
+	}
+#else
+	using Socket = int;
+	const Socket NO_SOCKET = -1;
+
+	void closeSocket(Socket socket) {
+		close(socket);
+	}
+#endif
+
+	/**
+		Every frame, both ways, is a little endian uint32 with the length of the rest, then the uint32 id of
+		the request and a byte: the op of a request or the status of a response. A request carries packed
+		StateKeys, 16 bytes each (lo then hi), as made by keyOf; keys without up and front centers are taken
+		with U up and F in front. Responses come back in the order they are done, not the order asked.
+
+		OP_SOLVE   per state a StateStatus byte, a uint16 move count and the move codes
+		OP_BOUND   per state the byte lowerBound gives, INVALID_STATE for states no cube can be in
+		OP_METRICS the metrics as text
+	*/
+	enum ServerOp : uint8_t { OP_SOLVE = 1, OP_BOUND = 2, OP_METRICS = 3 };
+	enum ServerStatus : uint8_t { STATUS_OK = 0, STATUS_BAD_REQUEST = 1 };
+	enum StateStatus : uint8_t { SOLVED = 0, TIMED_OUT = 1, SOLVER_FAILED = 2, INVALID_STATE = 0xFF };
+
+	const uint32_t MAX_FRAME = 16 << 20;
+
+	void putU32(string& to, uint32_t value) {
+		for (int i = 0; i < 4; i++) to.push_back(char(value >> (8 * i)));
+	}
+
+	uint64_t getLittleEndian(const char* from, int bytes) {
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; i++) value |= uint64_t(uint8_t(from[i])) << (8 * i);
+		return value;
+	}
+
+	struct ServerOptions {
+		string unixPath;	// only where RUBIKS_UNIX_SOCKETS is defined
+		int port = 0;	// on 127.0.0.1 only
+		unsigned threads = max(1u, thread::hardware_concurrency());
+		string solver = "simple";
+		chrono::milliseconds deadline{ 10000 };
+		size_t maxInFlight = 64;	// requests of one connection being worked on before it is not read any further
+		string sharedTables;	// shared memory segment to take the pattern tables from, see shared_tables.h
+		PageSize pages = SMALL_PAGES;	// for the pattern tables, see PatternTables::place
+		NumaPlacement numa = NUMA_DEFAULT;	// other than default also pins workers and connections to nodes round robin
+	};
+
+	// counts by powers of two of microseconds, cheap enough to record from every thread
+	class LatencyHistogram {
+	public:
+		static const int NUM_BUCKETS = 32;
+
+		void record(uint64_t us) {
+			int bucket = 0;
+			while (bucket < NUM_BUCKETS - 1 && (uint64_t(1) << bucket) <= us) bucket++;
+			buckets[bucket]++;
+			count++;
+			sum += us;
+		}
+
+		// upper bound of the bucket holding quantile q
+		uint64_t quantile(double q) const {
+			uint64_t total = count, seen = 0;
+			for (int i = 0; i < NUM_BUCKETS; i++) {
+				seen += buckets[i];
+				if (total && seen >= q * total) return uint64_t(1) << i;
+			}
+			return 0;
+		}
+
+		// in the prometheus text format
+		void dump(ostream& out, const string& name) const {
+			uint64_t cumulative = 0;
+			for (int i = 0; i < NUM_BUCKETS; i++) {
+				cumulative += buckets[i];
+				if (buckets[i]) out << name << "_bucket{le=\"" << (uint64_t(1) << i) << "\"} " << cumulative << '\n';
+			}
+			out << name << "_bucket{le=\"+Inf\"} " << count << '\n' << name << "_sum " << sum << '\n' << name << "_count " << count << '\n';
+			for (double q : { 0.5, 0.99, 0.999 }) out << name << "{quantile=\"" << q << "\"} " << quantile(q) << '\n';
+		}
+
+	private:
+		atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+		atomic<uint64_t> count{ 0 };
+		atomic<uint64_t> sum{ 0 };
+	};
+
+	struct ServerMetrics {
+		atomic<uint64_t> connectionsOpen{ 0 };
+		atomic<uint64_t> connectionsTotal{ 0 };
+		atomic<uint64_t> requests{ 0 };
+		atomic<uint64_t> badRequests{ 0 };
+		atomic<uint64_t> states{ 0 };
+		atomic<uint64_t> timeouts{ 0 };
+		atomic<uint64_t> invalidStates{ 0 };
+		atomic<int64_t> inFlight{ 0 };	// requests received and not answered yet
+		atomic<int64_t> queueDepth{ 0 };	// states waiting for a worker
+		atomic<int64_t> queueDepthMax{ 0 };
+		LatencyHistogram requestLatency;	// from reading a request to writing its response
+		LatencyHistogram solveLatency;	// of every state on its worker
+
+		string dump() const {
+			ostringstream out;
+			out << "rubiks_connections_open " << connectionsOpen << '\n'
+				<< "rubiks_connections_total " << connectionsTotal << '\n'
+				<< "rubiks_requests_total " << requests << '\n'
+				<< "rubiks_bad_requests_total " << badRequests << '\n'
+				<< "rubiks_states_total " << states << '\n'
+				<< "rubiks_states_timed_out_total " << timeouts << '\n'
+				<< "rubiks_states_invalid_total " << invalidStates << '\n'
+				<< "rubiks_requests_in_flight " << inFlight << '\n'
+				<< "rubiks_queue_depth " << queueDepth << '\n'
+				<< "rubiks_queue_depth_max " << queueDepthMax << '\n';
+			requestLatency.dump(out, "rubiks_request_latency_us");
+			solveLatency.dump(out, "rubiks_solve_latency_us");
+			return out.str();
+		}
+	};
+
+	class Connection {
+	public:
+		Connection(Socket socket) :socket(socket), inFlight(0) {}
+
+		~Connection() {
+			closeSocket(socket);
+		}
+
+		bool receive(char* to, size_t size) {
+			while (size > 0) {
+				int n = int(recv(socket, to, int(min(size, size_t(1) << 30)), 0));
+				if (n <= 0) return false;
+				to += n;
+				size -= n;
+			}
+			return true;
+		}
+
+		// writes a whole frame, from any thread; a client that went away just misses its responses
+		void respond(uint32_t id, uint8_t status, const string& payload) {
+			string frame;
+			putU32(frame, uint32_t(payload.size() + 5));
+			putU32(frame, id);
+			frame.push_back(char(status));
+			frame += payload;
+			lock_guard<mutex> guard(writeLock);
+			const char* from = frame.data();
+			size_t size = frame.size();
+			while (size > 0) {
+				int n = int(send(socket, from, int(min(size, size_t(1) << 30)), 0));
+				if (n <= 0) return;
+				from += n;
+				size -= n;
+			}
+		}
+
+		// waits until fewer than limit requests are being worked on and takes a place for one more
+		void beginRequest(size_t limit) {
+			unique_lock<mutex> guard(lock);
+			slots.wait(guard, [&]() { return inFlight < limit; });
+			inFlight++;
+		}
+
+		void endRequest() {
+			lock_guard<mutex> guard(lock);
+			inFlight--;
+			slots.notify_one();
+		}
+
+	private:
+		Socket socket;
+		mutex writeLock;
+		mutex lock;
+		condition_variable slots;
+		size_t inFlight;
+	};
+
+	// a batch of states to solve, answered when its last state is done
+	struct SolveRequest {
+		shared_ptr<Connection> connection;
+		uint32_t id;
+		vector<Snapshot> cubes;
+		vector<string> results;
+		atomic<size_t> remaining;
+		chrono::steady_clock::time_point received;
+	};
+
+	/**
+		Serves solves and lower bounds to any number of clients over a Unix domain socket or a TCP port on
+		127.0.0.1. Every connection has a thread reading its requests, which may be pipelined: solves are
+		split into states for a shared pool of worker threads, each with its own solver, and the response
+		is written as soon as the last state of the request is done, whatever came in before or after it.
+		A connection is not read any further while maxInFlight of its requests are in the works. Lower
+		bounds are answered right away by the reading thread from the pattern tables, which the server
+		builds once before it starts listening.
+	*/
+	class SolveServer {
+	public:
+		SolveServer(const ServerOptions& options) :options(options), listener(NO_SOCKET), stopping(false) {
+#ifdef _WIN32
+			WSADATA data;
+			WSAStartup(MAKEWORD(2, 2), &data);
+#else
+			signal(SIGPIPE, SIG_IGN);	// writes to a closed connection fail instead of ending the process
+#endif
+		}
+
+		~SolveServer() {
+			{
+				lock_guard<mutex> guard(queueLock);
+				stopping = true;
+			}
+			queued.notify_all();
+			for (thread& worker : workers) worker.join();
+			if (listener != NO_SOCKET) closeSocket(listener);
+		}
+
+		const ServerMetrics& counters() const {
+			return metrics;
+		}
+
+		// accepts connections until the process ends
+		void run(ostream& log) {
+			if (!options.sharedTables.empty()) {
+				bool shared = useSharedPatternTables(options.sharedTables);
+				log << (shared ? "pattern tables shared through " : "pattern tables private, unable to share ") << options.sharedTables << endl;
+			}
+			PatternTables::instance();
+			if (options.pages != SMALL_PAGES || options.numa != NUMA_DEFAULT) {
+				log << "pattern tables in " << PatternTables::place(options.pages, options.numa) << ", numa nodes: " << numaNodes() << endl;
+			}
+			compiledMoves();
+			listen();
+			for (unsigned i = 0; i < options.threads; i++) workers.emplace_back([this, i]() { work(int(i)); });
+			log << "listening on " << (options.unixPath.empty() ? "127.0.0.1:" + to_string(options.port) : options.unixPath)
+				<< " with " << options.threads << " workers" << endl;
+
+			for (;;) {
+				Socket socket = accept(listener, nullptr, nullptr);
+				if (socket == NO_SOCKET) continue;
+				if (options.unixPath.empty()) {
+					int on = 1;
+					setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+				}
+				metrics.connectionsOpen++;
+				int node = int(metrics.connectionsTotal++ % numaNodes());
+				thread(&SolveServer::serve, this, make_shared<Connection>(socket), node).detach();
+			}
+		}
+
+	private:
+		using Clock = chrono::steady_clock;
+		using Task = pair<shared_ptr<SolveRequest>, size_t>;
+
+		void listen() {
+#ifdef RUBIKS_UNIX_SOCKETS
+			if (!options.unixPath.empty()) {
+				sockaddr_un address = {};
+				address.sun_family = AF_UNIX;
+				if (options.unixPath.size() >= sizeof(address.sun_path)) throw runtime_error("socket path too long: " + options.unixPath);
+				memcpy(address.sun_path, options.unixPath.c_str(), options.unixPath.size() + 1);
+				remove(options.unixPath.c_str());
+				listener = socket(AF_UNIX, SOCK_STREAM, 0);
+				if (listener == NO_SOCKET || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+					throw runtime_error("unable to bind " + options.unixPath);
+				}
+			}
+			else
+#endif
+			{
+				sockaddr_in address = {};
+				address.sin_family = AF_INET;
+				address.sin_port = htons(uint16_t(options.port));
+				address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+				listener = socket(AF_INET, SOCK_STREAM, 0);
+				int on = 1;
+				setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+				if (listener == NO_SOCKET || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+					throw runtime_error("unable to bind 127.0.0.1:" + to_string(options.port));
+				}
+			}
+			if (::listen(listener, SOMAXCONN) != 0) throw runtime_error("unable to listen");
+		}
+
+		// reads the requests of one connection until the client closes it
+		// node is where the bounds this connection asks for are looked up when the tables are placed
+		void serve(shared_ptr<Connection> connection, int node) {
+			if (options.numa != NUMA_DEFAULT) pinToNode(node);
+			char header[4];
+			string body;
+			while (connection->receive(header, sizeof(header))) {
+				uint32_t length = uint32_t(getLittleEndian(header, 4));
+				if (length < 5 || length > MAX_FRAME) {
+					metrics.badRequests++;
+					connection->respond(0, STATUS_BAD_REQUEST, "bad frame length");
+					break;
+				}
+				body.resize(length);
+				if (!connection->receive(&body[0], length)) break;
+				metrics.requests++;
+				uint32_t id = uint32_t(getLittleEndian(body.data(), 4));
+				uint8_t op = uint8_t(body[4]);
+				size_t keys = (length - 5) / 16;
+				if (op == OP_METRICS) {
+					connection->respond(id, STATUS_OK, metrics.dump());
+				}
+				else if ((op != OP_SOLVE && op != OP_BOUND) || (length - 5) % 16 != 0) {
+					metrics.badRequests++;
+					connection->respond(id, STATUS_BAD_REQUEST, "unknown op or partial state");
+				}
+				else if (op == OP_BOUND) {
+					bound(*connection, id, body.data() + 5, keys);
+				}
+				else {
+					solve(connection, id, body.data() + 5, keys);
+				}
+			}
+			metrics.connectionsOpen--;
+		}
+
+		// the cube a packed key describes, false when no cube can be like that
+		bool unpack(const char* data, Snapshot& cube) {
+			StateKey key;
+			key.lo = getLittleEndian(data, 8);
+			key.hi = getLittleEndian(data + 8, 8);
+			cube.up = uint8_t(key.hi >> 40 & 0xF);
+			cube.front = uint8_t(key.hi >> 44 & 0xF);
+			key.hi &= (uint64_t(1) << 40) - 1;
+			cube.state = key.state();
+			if (cube.up == cube.front) {
+				cube.up = uint8_t(faceIndex(UP));
+				cube.front = uint8_t(faceIndex(FRONT));
+			}
+			if (cube.up >= NUM_FACES || cube.front >= NUM_FACES || dot(FACE_DIRECTIONS[cube.up], FACE_DIRECTIONS[cube.front]) != 0) return false;
+			if (StateKey(cube.state) != key) return false;	// pieces out of range
+			try {
+				checkState(cube.state);
+			}
+			catch (const char*) {
+				return false;
+			}
+			return true;
+		}
+
+		void bound(Connection& connection, uint32_t id, const char* data, size_t count) {
+			auto begin = Clock::now();
+			vector<CubeState> states;
+			string payload(count, char(INVALID_STATE));
+			vector<size_t> valid;
+			for (size_t i = 0; i < count; i++) {
+				Snapshot cube;
+				if (!unpack(data + 16 * i, cube)) {
+					metrics.invalidStates++;
+					continue;
+				}
+				states.push_back(cube.state);
+				valid.push_back(i);
+			}
+			vector<uint8_t> bounds = lowerBounds(states);
+			for (size_t i = 0; i < valid.size(); i++) payload[valid[i]] = char(bounds[i]);
+			metrics.states += count;
+			connection.respond(id, STATUS_OK, payload);
+			metrics.requestLatency.record(chrono::duration_cast<chrono::microseconds>(Clock::now() - begin).count());
+		}
+
+		void solve(shared_ptr<Connection> connection, uint32_t id, const char* data, size_t count) {
+			connection->beginRequest(options.maxInFlight);
+			metrics.inFlight++;
+			shared_ptr<SolveRequest> request = make_shared<SolveRequest>();
+			request->connection = connection;
+			request->id = id;
+			request->cubes.resize(count);
+			request->results.resize(count);
+			request->remaining = count + 1;	// held until every state is handed out
+			request->received = Clock::now();
+			metrics.states += count;
+
+			vector<Task> tasks;
+			for (size_t i = 0; i < count; i++) {
+				if (unpack(data + 16 * i, request->cubes[i])) {
+					tasks.push_back({ request, i });
+				}
+				else {
+					metrics.invalidStates++;
+					request->results[i] = string(1, char(INVALID_STATE)) + string(2, '\0');
+					request->remaining--;
+				}
+			}
+			if (!tasks.empty()) {
+				lock_guard<mutex> guard(queueLock);
+				pending.insert(pending.end(), tasks.begin(), tasks.end());
+				int64_t depth = metrics.queueDepth += tasks.size();
+				if (depth > metrics.queueDepthMax) metrics.queueDepthMax = depth;
+			}
+			queued.notify_all();
+			finish(request);
+		}
+
+		// counts down the states of request and answers it after the last
+		void finish(const shared_ptr<SolveRequest>& request) {
+			if (--request->remaining > 0) return;
+			string payload;
+			for (const string& result : request->results) payload += result;
+			request->connection->respond(request->id, STATUS_OK, payload);
+			request->connection->endRequest();
+			metrics.inFlight--;
+			metrics.requestLatency.record(chrono::duration_cast<chrono::microseconds>(Clock::now() - request->received).count());
+		}
+
+		void work(int index) {
+			if (options.numa != NUMA_DEFAULT) pinToNode(index % numaNodes());
+			unique_ptr<Solver> solver = makeSolver(options.solver);
+			for (;;) {
+				Task task;
+				{
+					unique_lock<mutex> guard(queueLock);
+					queued.wait(guard, [&]() { return stopping || !pending.empty(); });
+					if (stopping) return;
+					task = pending.front();
+					pending.pop_front();
+					metrics.queueDepth--;
+				}
+				SolveRequest& request = *task.first;
+				auto begin = Clock::now();
+				RubiksCube cube;
+				restore(cube, request.cubes[task.second]);
+				SolveLimits limits = SolveLimits::within(options.deadline);
+				Solution solution;
+				bool failed = false;
+				try {
+					solution = solver->solve(cube, limits);
+				}
+				catch (...) {
+					failed = true;
+				}
+				failed = failed || (solution.empty() && !request.cubes[task.second].state.isSolved());
+				bool expired = failed && limits.expired();
+
+				string& result = request.results[task.second];
+				result.push_back(char(!failed ? SOLVED : expired ? TIMED_OUT : SOLVER_FAILED));
+				result.push_back(char(solution.size()));
+				result.push_back(char(solution.size() >> 8));
+				for (MoveCode m : solution) result.push_back(char(m));
+				if (expired) metrics.timeouts++;
+				metrics.solveLatency.record(chrono::duration_cast<chrono::microseconds>(Clock::now() - begin).count());
+				finish(task.first);
+			}
+		}
+
+		ServerOptions options;
+		ServerMetrics metrics;
+		Socket listener;
+		vector<thread> workers;
+		mutex queueLock;
+		condition_variable queued;
+		deque<Task> pending;	// states waiting for a worker
+		bool stopping;
+	};
+}
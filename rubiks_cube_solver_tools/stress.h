@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../rubiks_cube_solver/model.h"
+#include "../rubiks_cube_solver/moves.h"
+#include "../rubiks_cube_solver/solver.h"
+#include "../rubiks_cube_solver/state.h"
+#include "../rubiks_cube_solver/sequence.h"
+#include "../rubiks_cube_solver/bidirectional.h"
+
+namespace rubiks {
+
+	using Scramble = vector<MoveCode>;
+
+	struct StressOptions {
+		size_t count = 100000;
+		unsigned threads = max(1u, thread::hardware_concurrency());
+		chrono::milliseconds deadline{ 10000 };
+		int scrambleLength = 20;
+		string solver = "simple";
+		string failures = "failures.txt";
+		string replay;	// file of scrambles to run instead of random ones
+	};
+
+	unique_ptr<Solver> makeSolver(const string& name) {
+		if (name == "bidirectional") return unique_ptr<Solver>(new BidirectionalSolver);
+		return unique_ptr<Solver>(new SimpleSolver);
+	}
+
+	/**
+		One line per scramble: the move codes, then a comment with the reason and the move names, e.g.
+		"1 10 7 # wrong solution: R -U -R". Lines written by a stress run can be fed back with --replay.
+	*/
+	string formatScramble(const Scramble& scramble, const string& reason) {
+		ostringstream line;
+		for (MoveCode m : scramble) line << int(m) << ' ';
+		line << "# " << reason << ':';
+		for (MoveCode m : scramble) line << ' ' << MOVE_INFO[m].name;
+		return line.str();
+	}
+
+	vector<Scramble> readScrambles(const string& path) {
+		ifstream in(path);
+		if (!in) {
+			throw runtime_error("unable to open " + path);
+		}
+		vector<Scramble> scrambles;
+		for (string line; getline(in, line);) {
+			istringstream moves(line.substr(0, line.find('#')));
+			Scramble scramble;
+			for (int m; moves >> m;) {
+				if (m < 0 || m >= NUM_MOVES) throw runtime_error("bad move code in " + path + ": " + line);
+				scramble.push_back(MoveCode(m));
+			}
+			if (!scramble.empty()) scrambles.push_back(scramble);
+		}
+		return scrambles;
+	}
+
+	/**
+		Solves count random scrambles (or the scrambles of a replay file) on a pool of threads, checks every
+		solution by replaying it and reports throughput, latency percentiles and a histogram of solution
+		lengths. Failures are appended to options.failures in the readScrambles format.
+
+		Every solve gets the deadline as its SolveLimits and stops itself when it runs out, which counts as a
+		timeout. A watchdog still abandons a worker whose solve runs twice past the deadline without
+		stopping, and the run finishes on the remaining ones.
+	*/
+	class StressRun {
+	public:
+		StressRun(const StressOptions& options) :options(options), workers(options.threads) {
+			if (!options.replay.empty()) {
+				replay = readScrambles(options.replay);
+				this->options.count = replay.size();
+			}
+		}
+
+		// returns the number of failures
+		size_t run(ostream& out) {
+			auto start = Clock::now();
+			vector<thread> threads;
+			for (unsigned i = 0; i < options.threads; i++) {
+				threads.emplace_back([this, i]() { work(workers[i], i); });
+			}
+
+			while (finished.load() + abandoned() < options.threads) {
+				watch();
+				this_thread::sleep_for(chrono::milliseconds(10));
+			}
+			double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+			for (unsigned i = 0; i < options.threads; i++) {
+				if (workers[i].abandoned) threads[i].detach();
+				else threads[i].join();
+			}
+			report(out, seconds);
+			return timeouts + exceptions + wrong;
+		}
+
+		size_t hungWorkers() const {
+			return abandoned();
+		}
+
+	private:
+		using Clock = chrono::steady_clock;
+		static const int BUCKET = 10;
+		static const int NUM_BUCKETS = 60;
+
+		struct Worker {
+			mutable mutex lock;
+			Scramble current;
+			atomic<int64_t> startedAt{ 0 };	// Clock ticks, 0 when idle
+			bool abandoned = false;
+			vector<uint32_t> latencies;	// microseconds
+			size_t histogram[NUM_BUCKETS] = {};
+		};
+
+		void work(Worker& worker, unsigned id) {
+			mt19937 rng(random_device{}() + id);
+			unique_ptr<Solver> solver = makeSolver(options.solver);
+			for (size_t i; (i = next++) < options.count;) {
+				Scramble scramble = replay.empty() ? randomScramble(rng) : replay[i];
+				RubiksCube cube;
+				for (MoveCode m : scramble) applyMove(cube, m);
+				{
+					lock_guard<mutex> guard(worker.lock);
+					worker.current = scramble;
+				}
+
+				auto begin = Clock::now();
+				worker.startedAt = begin.time_since_epoch().count();
+				Solution solution;
+				SolveLimits limits = SolveLimits::within(options.deadline);
+				bool threw = false;
+				try {
+					solution = solver->solve(cube, limits);
+				}
+				catch (...) {
+					threw = true;
+				}
+				bool expired = limits.expired();
+				auto elapsed = Clock::now() - begin;
+				worker.startedAt = 0;
+				{
+					lock_guard<mutex> guard(worker.lock);
+					if (worker.abandoned) return;	// the watchdog already reported it
+				}
+
+				size_t length = solution.size();
+				if (expired && (threw || solution.empty())) {
+					fail(scramble, "timeout", timeouts);
+				}
+				else if (threw) {
+					fail(scramble, "exception", exceptions);
+				}
+				else if (!solves(scramble, solution)) {
+					fail(scramble, "wrong solution", wrong);
+				}
+				worker.latencies.push_back(uint32_t(chrono::duration_cast<chrono::microseconds>(elapsed).count()));
+				worker.histogram[min(length / BUCKET, size_t(NUM_BUCKETS - 1))]++;
+			}
+			finished++;
+		}
+
+		Scramble randomScramble(mt19937& rng) {
+			uniform_int_distribution<int> move(0, NUM_MOVES - 1);
+			Scramble scramble(options.scrambleLength);
+			for (MoveCode& m : scramble) m = MoveCode(move(rng));
+			return scramble;
+		}
+
+		// composes scramble and solution into one permutation instead of replaying them on a cube
+		bool solves(const Scramble& scramble, const Solution& solution) {
+			CompiledSequence whole = compile(scramble.begin(), scramble.end()) * compile(solution.begin(), solution.end());
+			return applySequence(CubeState::solved(), whole).isSolved();
+		}
+
+		// abandons workers stuck past twice the deadline, their solver did not stop at it
+		void watch() {
+			int64_t now = Clock::now().time_since_epoch().count();
+			int64_t deadline = 2 * chrono::duration_cast<Clock::duration>(options.deadline).count();
+			for (Worker& worker : workers) {
+				int64_t started = worker.startedAt;
+				if (started == 0 || now - started <= deadline) continue;
+				Scramble scramble;
+				{
+					lock_guard<mutex> guard(worker.lock);
+					if (worker.abandoned || worker.startedAt == 0) continue;
+					worker.abandoned = true;
+					scramble = worker.current;
+				}
+				fail(scramble, "timeout", timeouts);
+			}
+		}
+
+		unsigned abandoned() const {
+			unsigned count = 0;
+			for (const Worker& worker : workers) {
+				lock_guard<mutex> guard(worker.lock);
+				count += worker.abandoned;
+			}
+			return count;
+		}
+
+		void fail(const Scramble& scramble, const string& reason, size_t& counter) {
+			lock_guard<mutex> guard(failureLock);
+			counter++;
+			if (!failureFile.is_open()) failureFile.open(options.failures, ios::app);
+			failureFile << formatScramble(scramble, reason) << endl;
+		}
+
+		void report(ostream& out, double seconds) {
+			vector<uint32_t> latencies;
+			size_t histogram[NUM_BUCKETS] = {};
+			for (Worker& worker : workers) {
+				latencies.insert(latencies.end(), worker.latencies.begin(), worker.latencies.end());
+				for (int i = 0; i < NUM_BUCKETS; i++) histogram[i] += worker.histogram[i];
+			}
+			sort(latencies.begin(), latencies.end());
+			auto percentile = [&](double p) {
+				return latencies.empty() ? 0 : latencies[min(latencies.size() - 1, size_t(p * latencies.size()))];
+			};
+
+			out << latencies.size() << " of " << options.count << " scrambles solved in " << seconds << " s on " << options.threads << " threads, "
+				<< size_t(latencies.size() / max(seconds, 1e-9)) << " solves/s" << endl;
+			out << "latency us: p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", p999 " << percentile(0.999)
+				<< ", max " << (latencies.empty() ? 0 : latencies.back()) << endl;
+			out << "failures: " << timeouts << " timeouts, " << exceptions << " exceptions, " << wrong << " wrong solutions";
+			if (timeouts + exceptions + wrong) out << " (written to " << options.failures << ")";
+			out << endl;
+
+			size_t largest = *max_element(begin(histogram), end(histogram));
+			out << "solution length:" << endl;
+			for (int i = 0; i < NUM_BUCKETS; i++) {
+				if (histogram[i] == 0) continue;
+				out << "  " << i * BUCKET << (i == NUM_BUCKETS - 1 ? "+" : "-" + to_string(i * BUCKET + BUCKET - 1)) << '\t'
+					<< string(40 * histogram[i] / largest, '#') << ' ' << histogram[i] << endl;
+			}
+		}
+
+		StressOptions options;
+		vector<Scramble> replay;
+		vector<Worker> workers;
+		atomic<size_t> next{ 0 };
+		atomic<unsigned> finished{ 0 };
+		mutex failureLock;
+		ofstream failureFile;
+		size_t timeouts = 0;
+		size_t exceptions = 0;
+		size_t wrong = 0;
+	};
+}
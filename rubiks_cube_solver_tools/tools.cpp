@@ -0,0 +1,272 @@
+// tools.cpp : command line tools that run the solvers without the renderer.
+//
+//   rubiks_cube_solver_tools stress [--count n] [--threads n] [--deadline ms] [--length n]
+//                                   [--solver simple|bidirectional] [--failures file] [--replay file]
+//   rubiks_cube_solver_tools solve <facelets> [--solver simple|bidirectional]
+//   rubiks_cube_solver_tools enumerate [--depth n] [--from facelets] [--out file] [--spill directory [--memory mb]]
+//   rubiks_cube_solver_tools serve (--unix path | --port n) [--threads n] [--solver simple|bidirectional]   (no --unix on Windows)
+//                                  [--deadline ms] [--in-flight n] [--shared-tables name]
+//                                  [--pages 4k|2m|1g] [--numa default|interleave|replicate]
+//   rubiks_cube_solver_tools tables (publish | remove | status) [--name name]
+//
+
+#define GLM_SWIZZLE
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "server.h"
+#include "stress.h"
+#include "../rubiks_cube_solver/enumerate.h"
+#include "../rubiks_cube_solver/external_bfs.h"
+#include "../rubiks_cube_solver/facelets.h"
+
+using namespace std;
+using namespace rubiks;
+
+// swallows the progress messages the solvers print
+class NullBuffer : public streambuf {
+protected:
+	int overflow(int c) override {
+		return c;
+	}
+};
+
+int usage() {
+	cerr << "usage: rubiks_cube_solver_tools stress [--count n] [--threads n] [--deadline ms] [--length n]" << endl
+		<< "                                      [--solver simple|bidirectional] [--failures file] [--replay file]" << endl
+		<< "       rubiks_cube_solver_tools solve <facelets> [--solver simple|bidirectional]" << endl
+		<< "       rubiks_cube_solver_tools enumerate [--depth n] [--from facelets] [--out file] [--spill directory [--memory mb]]" << endl
+#ifdef RUBIKS_UNIX_SOCKETS
+		<< "       rubiks_cube_solver_tools serve (--unix path | --port n) [--threads n] [--solver simple|bidirectional]" << endl
+#else
+		<< "       rubiks_cube_solver_tools serve --port n [--threads n] [--solver simple|bidirectional]" << endl
+#endif
+		<< "                                      [--deadline ms] [--in-flight n] [--shared-tables name]" << endl
+		<< "                                      [--pages 4k|2m|1g] [--numa default|interleave|replicate]" << endl
+		<< "       rubiks_cube_solver_tools tables (publish | remove | status) [--name name]" << endl;
+	return 2;
+}
+
+int stress(int argc, char** argv) {
+	StressOptions options;
+	for (int i = 0; i + 1 < argc; i += 2) {
+		string flag = argv[i];
+		string value = argv[i + 1];
+		if (flag == "--count") options.count = stoull(value);
+		else if (flag == "--threads") options.threads = max(1, stoi(value));
+		else if (flag == "--deadline") options.deadline = chrono::milliseconds(stoi(value));
+		else if (flag == "--length") options.scrambleLength = stoi(value);
+		else if (flag == "--solver") options.solver = value;
+		else if (flag == "--failures") options.failures = value;
+		else if (flag == "--replay") options.replay = value;
+		else return usage();
+	}
+	if (argc % 2) return usage();
+
+	NullBuffer discard;
+	streambuf* console = cout.rdbuf(&discard);
+	ostream out(console);
+
+	StressRun run(options);
+	size_t failures = run.run(out);
+	out.flush();
+	cout.rdbuf(console);
+
+	int status = failures ? 1 : 0;
+	if (run.hungWorkers()) {
+		// hung solver threads cannot be joined, leave without running static destructors under them
+		cout.flush();
+		quick_exit(status);
+	}
+	return status;
+}
+
+// solves the cube of a 54 facelet string (URFDLB order), which is checked before any solver sees it
+int solve(int argc, char** argv) {
+	if (argc != 1 && !(argc == 3 && string(argv[1]) == "--solver")) return usage();
+	RubiksCube cube;
+	try {
+		loadFacelets(cube, argv[0]);
+	}
+	catch (const char* msg) {
+		cerr << "invalid cube: " << msg << endl;
+		return 2;
+	}
+
+	NullBuffer discard;
+	streambuf* console = cout.rdbuf(&discard);
+	Solution solution = makeSolver(argc == 3 ? argv[2] : "simple")->solve(cube);
+	cout.rdbuf(console);
+
+	for (MoveCode m : solution) cout << MOVE_INFO[m].name << ' ';
+	cout << endl << solution.size() << " moves" << endl;
+	return 0;
+}
+
+// one line per depth: the states there, the states up to it, the successors they came from and the time taken
+template<typename Enumerator>
+void enumerateTo(Enumerator& enumerator, int maxDepth, ofstream& corpus) {
+	auto write = [&]() {
+		if (!corpus.is_open()) return;
+		enumerator.forEach([&](const CubeState& state) { corpus << enumerator.depth() << ' ' << faceletsOf(state) << '\n'; });
+	};
+	write();
+	uint64_t total = 1;
+	cout << setw(6) << "depth" << setw(14) << "states" << setw(14) << "total" << setw(14) << "generated" << setw(10) << "seconds" << setw(14) << "states/s" << endl;
+	cout << setw(6) << 0 << setw(14) << 1 << setw(14) << 1 << setw(14) << 0 << setw(10) << 0 << setw(14) << 0 << endl;
+	while (enumerator.depth() < maxDepth) {
+		auto begin = chrono::steady_clock::now();
+		uint64_t count = enumerator.expand();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+		total += count;
+		cout << setw(6) << enumerator.depth() << setw(14) << count << setw(14) << total << setw(14) << enumerator.generated()
+			<< setw(10) << fixed << setprecision(3) << seconds << setw(14) << setprecision(0) << count / max(seconds, 1e-9) << endl;
+		write();
+	}
+}
+
+/**
+	Counts the states at every distance up to --depth quarter turns from solved, or from the --from cube,
+	and how fast they were found. --out writes every state, one "depth facelets" line each, as a corpus
+	of cubes with known distances. With --spill the layers go to run files in that directory and only
+	--memory MB of successors (1024 by default) are sorted in memory at a time.
+*/
+int enumerate(int argc, char** argv) {
+	int maxDepth = 7;
+	CubeState start = CubeState::solved();
+	string out, spill;
+	size_t memory = 1024;
+	if (argc % 2) return usage();
+	for (int i = 0; i + 1 < argc; i += 2) {
+		string flag = argv[i];
+		string value = argv[i + 1];
+		if (flag == "--depth") maxDepth = stoi(value);
+		else if (flag == "--from") {
+			try {
+				start = parseFacelets(value);
+			}
+			catch (const char* msg) {
+				cerr << "invalid cube: " << msg << endl;
+				return 2;
+			}
+		}
+		else if (flag == "--out") out = value;
+		else if (flag == "--spill") spill = value;
+		else if (flag == "--memory") memory = stoull(value);
+		else return usage();
+	}
+
+	ofstream corpus;
+	if (!out.empty()) {
+		corpus.open(out);
+		if (!corpus) {
+			cerr << "unable to open " << out << endl;
+			return 1;
+		}
+	}
+	if (spill.empty()) {
+		DepthEnumerator enumerator(start);
+		enumerateTo(enumerator, maxDepth, corpus);
+	}
+	else {
+		ExternalEnumerator enumerator(start, spill, memory << 20);
+		enumerateTo(enumerator, maxDepth, corpus);
+		cout << "last layer: " << enumerator.diskSize() << " bytes on disk, merged from " << enumerator.runs() << " runs in " << enumerator.passes() << " passes" << endl;
+	}
+	return 0;
+}
+
+// runs a solve server until the process is killed, see server.h for the protocol
+int serve(int argc, char** argv) {
+	ServerOptions options;
+	if (argc % 2) return usage();
+	for (int i = 0; i + 1 < argc; i += 2) {
+		string flag = argv[i];
+		string value = argv[i + 1];
+#ifdef RUBIKS_UNIX_SOCKETS
+		if (flag == "--unix") options.unixPath = value;
+		else
+#endif
+		if (flag == "--port") options.port = stoi(value);
+		else if (flag == "--threads") options.threads = max(1, stoi(value));
+		else if (flag == "--solver") options.solver = value;
+		else if (flag == "--deadline") options.deadline = chrono::milliseconds(stoi(value));
+		else if (flag == "--in-flight") options.maxInFlight = max(1, stoi(value));
+		else if (flag == "--shared-tables") options.sharedTables = value;
+		else if (flag == "--pages" && (value == "4k" || value == "2m" || value == "1g")) options.pages = value == "4k" ? SMALL_PAGES : value == "2m" ? HUGE_PAGES_2MB : HUGE_PAGES_1GB;
+		else if (flag == "--numa" && (value == "default" || value == "interleave" || value == "replicate")) options.numa = value == "default" ? NUMA_DEFAULT : value == "interleave" ? NUMA_INTERLEAVE : NUMA_REPLICATE;
+		else return usage();
+	}
+	if (options.unixPath.empty() == (options.port == 0)) return usage();
+
+	NullBuffer discard;
+	streambuf* console = cout.rdbuf(&discard);
+	ostream log(console);
+	SolveServer server(options);
+	server.run(log);
+	return 0;
+}
+
+// manages the shared memory segment solver processes take the pattern tables from
+int tables(int argc, char** argv) {
+	if (argc != 1 && !(argc == 3 && string(argv[1]) == "--name")) return usage();
+	string action = argv[0];
+	string name = argc == 3 ? argv[2] : DEFAULT_SHARED_TABLES;
+	if (action == "publish") {
+		auto start = chrono::steady_clock::now();
+		auto shared = SharedPatternTables::publish(name, true);
+		cout << "published " << PatternTables::size() << " bytes of pattern tables to " << name << " in "
+			<< chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+#ifdef _WIN32
+		cout << "the segment lasts while a process maps it, press enter to let it go" << endl;
+		cin.get();
+#endif
+		return 0;
+	}
+	if (action == "remove") {
+#ifdef _WIN32
+		cout << name << " cannot be removed on Windows, it goes away when the last process that maps it unmaps it" << endl;
+		return 1;
+#else
+		if (!SharedPatternTables::remove(name)) throw runtime_error("no shared memory " + name);
+		return 0;
+#endif
+	}
+	if (action == "status") {
+		auto start = chrono::steady_clock::now();
+		auto shared = SharedPatternTables::attach(name);
+		if (!shared) {
+			cout << name << ": missing, being published, or of another version" << endl;
+			return 1;
+		}
+		cout << name << ": version " << shared->info().version << ", " << shared->info().size << " bytes, attached in "
+			<< chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() << " us" << endl;
+		return 0;
+	}
+	return usage();
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) return usage();
+	string command = argv[1];
+	try {
+		if (command == "stress") return stress(argc - 2, argv + 2);
+		if (command == "solve" && argc > 2) return solve(argc - 2, argv + 2);
+		if (command == "enumerate") return enumerate(argc - 2, argv + 2);
+		if (command == "serve") return serve(argc - 2, argv + 2);
+		if (command == "tables" && argc > 2) return tables(argc - 2, argv + 2);
+	}
+	catch (const char* msg) {
+		cerr << msg << endl;
+		return 1;
+	}
+	catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+	return usage();
+}